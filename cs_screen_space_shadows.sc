@@ -0,0 +1,122 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+#include "linear_depth.sh"
+
+// Each group shades a TILE_SIZE x TILE_SIZE block of pixels. Before marching,
+// the group cooperatively loads a CACHE_SIZE x CACHE_SIZE block of linear
+// depth into groupshared memory. The cache is shifted towards the light in
+// screen space, so the tile sits at the edge of the cache facing away from
+// the light, and most samples along the rays are found in the cache. With
+// several lights the cache stays centered on the tile and is shared by all of
+// them. Samples that leave the cache fall back to a regular texture fetch.
+
+#define TILE_SIZE			8
+#define CACHE_SIZE			32
+#define CACHE_TEXELS		(CACHE_SIZE*CACHE_SIZE)
+#define LOADS_PER_THREAD	(CACHE_TEXELS / (TILE_SIZE*TILE_SIZE))
+
+SAMPLER2D(s_depth, 0);
+IMAGE2D_WR(s_shadowsOut, rgba8, 1);
+SAMPLER2D(s_hiz, 2);
+SAMPLER2D(s_blueNoise, 3);
+
+SHARED float s_depthCache[CACHE_TEXELS];
+SHARED ivec2 s_cacheOrigin;
+
+float SampleDepthCached(vec2 coord)
+{
+	ivec2 texel = ivec2(floor(coord * u_shadowsSize));
+	ivec2 local = texel - s_cacheOrigin;
+	if (0 <= local.x && local.x < CACHE_SIZE
+	&&  0 <= local.y && local.y < CACHE_SIZE)
+	{
+		return s_depthCache[local.y * CACHE_SIZE + local.x];
+	}
+
+	return ResolveLinearDepth(texture2DLod(s_depth, coord, 0).x);
+}
+
+#define SSS_SAMPLE_DEPTH(_coord) SampleDepthCached(_coord)
+#define SSS_SAMPLE_HIZ(_texel, _levelSize, _level) texelFetch(s_hiz, ivec2(_texel), int(_level)).x
+#define SSS_SAMPLE_BLUE_NOISE(_fragCoord) texture2DLod(s_blueNoise, (_fragCoord) / BLUE_NOISE_SIZE, 0).x
+
+#include "screen_space_shadows.sh"
+
+// project light into texel coordinates and return screen space direction rays
+// will travel from the tile, or zero if that direction is not well defined
+vec2 LightDirectionInTexels(vec2 tileCenter)
+{
+	mat4 viewToProj = mat4(
+		u_viewToProj0,
+		u_viewToProj1,
+		u_viewToProj2,
+		u_viewToProj3
+	);
+
+	// with several lights there is no single direction, keep tile centered
+	if (1.5 < u_lightCount)
+	{
+		return vec2_splat(0.0);
+	}
+
+	vec4 psLight = instMul(viewToProj, vec4(u_lightPosition0, 1.0));
+	if (abs(psLight.w) < 1e-5)
+	{
+		return vec2_splat(0.0);
+	}
+
+	vec2 lightCoord = (psLight.xy / psLight.w) * 0.5 + 0.5;
+	lightCoord.y = 1.0 - lightCoord.y;
+
+	// when light is behind camera, rays head away from its projection
+	vec2 direction = (lightCoord * u_shadowsSize - tileCenter) * sign(psLight.w);
+	float directionLength = length(direction);
+	return (1.0 < directionLength) ? (direction / directionLength) : vec2_splat(0.0);
+}
+
+NUM_THREADS(TILE_SIZE, TILE_SIZE, 1)
+void main()
+{
+	ivec2 tileOrigin = ivec2(gl_WorkGroupID.xy) * TILE_SIZE;
+	uint localIndex = gl_LocalInvocationIndex;
+
+	if (0u == localIndex)
+	{
+		vec2 tileCenter = vec2(tileOrigin) + vec2_splat(0.5 * float(TILE_SIZE));
+		vec2 direction = LightDirectionInTexels(tileCenter);
+		vec2 cacheCenter = tileCenter + direction * (0.5 * float(CACHE_SIZE - TILE_SIZE));
+		s_cacheOrigin = ivec2(floor(cacheCenter)) - ivec2(CACHE_SIZE/2, CACHE_SIZE/2);
+	}
+	barrier();
+
+	ivec2 cacheOrigin = s_cacheOrigin;
+	ivec2 maxTexel = ivec2(u_shadowsSize) - ivec2(1, 1);
+	for (int ii = 0; ii < LOADS_PER_THREAD; ++ii)
+	{
+		int cacheIndex = int(localIndex) + ii * (TILE_SIZE*TILE_SIZE);
+		ivec2 texel = cacheOrigin + ivec2(cacheIndex % CACHE_SIZE, cacheIndex / CACHE_SIZE);
+		texel = clamp(texel, ivec2(0, 0), maxTexel);
+		vec2 coord = (vec2(texel) + vec2_splat(0.5)) / u_shadowsSize;
+		s_depthCache[cacheIndex] = ResolveLinearDepth(texture2DLod(s_depth, coord, 0).x);
+	}
+	barrier();
+
+	ivec2 pixel = ivec2(gl_GlobalInvocationID.xy);
+	if (pixel.x > maxTexel.x || pixel.y > maxTexel.y)
+	{
+		return;
+	}
+
+	vec2 fragCoord = vec2(pixel) + vec2_splat(0.5);
+	vec2 texCoord = fragCoord / u_shadowsSize;
+	float linearDepth = SampleDepthCached(texCoord);
+
+	vec4 shadows = ScreenSpaceShadows(texCoord, fragCoord, linearDepth);
+
+	imageStore(s_shadowsOut, pixel, shadows);
+}
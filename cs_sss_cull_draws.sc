@@ -0,0 +1,39 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+
+// Write indexed indirect draw arguments for every group of every mesh, with
+// instance count from cs_sss_cull_models, then reset counts for next frame.
+// Single group, so reading counts finishes before they are reset.
+
+#define GROUP_SIZE		64
+#define MESH_COUNT		5
+
+BUFFER_RO(b_drawInfo, uint, 0);		// mesh and index count, per draw
+BUFFER_RW(b_meshCounts, uint, 1);
+BUFFER_WR(b_indirect, uvec4, 2);
+
+SHARED uint s_meshCounts[MESH_COUNT];
+
+NUM_THREADS(GROUP_SIZE, 1, 1)
+void main()
+{
+	uint idx = gl_LocalInvocationIndex;
+	if (idx < uint(MESH_COUNT))
+	{
+		s_meshCounts[idx] = b_meshCounts[idx];
+		b_meshCounts[idx] = 0u;
+	}
+	barrier();
+
+	if (idx < uint(u_cullDrawCount))
+	{
+		uint mesh = b_drawInfo[idx * 2u];
+		uint numIndices = b_drawInfo[idx * 2u + 1u];
+		drawIndexedIndirect(b_indirect, idx, numIndices, s_meshCounts[mesh], 0u, 0u, 0u);
+	}
+}
@@ -0,0 +1,132 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+
+// Test bounding sphere of every model against the view frustum, and
+// optionally against previous frame's max depth pyramid. Visible instances
+// are packed at the start of their mesh's range of the culled instance
+// buffer, and counted per mesh for cs_sss_cull_draws.
+
+#define GROUP_SIZE		64
+
+BUFFER_RO(b_instances, vec4, 0);		// position in xyz, scale in w, sorted by mesh
+BUFFER_WR(b_culledInstances, vec4, 1);
+BUFFER_RW(b_meshCounts, uint, 2);
+SAMPLER2D(s_hizMax, 3);
+
+// Previous frame's depth is in front of whole sphere. Sphere's screen rect is
+// covered by 2x2 texels of a level of the pyramid, using same texel mapping as
+// cs_sss_hiz_downsample where last texel of a level covers the odd remainder
+bool IsOccluded(vec3 center, float radius)
+{
+	mat4 worldToPrevView = mat4(
+		u_worldToPrevView0,
+		u_worldToPrevView1,
+		u_worldToPrevView2,
+		u_worldToPrevView3
+	);
+	mat4 prevViewToProj = mat4(
+		u_prevViewToProj0,
+		u_prevViewToProj1,
+		u_prevViewToProj2,
+		u_prevViewToProj3
+	);
+
+	vec3 viewCenter = instMul(worldToPrevView, vec4(center, 1.0)).xyz;
+	float nearestDepth = viewCenter.z - radius;
+	if (nearestDepth <= u_cameraNear)
+	{
+		// crosses near plane
+		return false;
+	}
+
+	// project corners of sphere's bounding box, all are in front of camera
+	vec2 uvMin = vec2_splat(1.0);
+	vec2 uvMax = vec2_splat(0.0);
+	for (int ii = 0; ii < 8; ++ii)
+	{
+		vec3 corner = viewCenter + radius * vec3(
+			(ii & 1) != 0 ? 1.0 : -1.0,
+			(ii & 2) != 0 ? 1.0 : -1.0,
+			(ii & 4) != 0 ? 1.0 : -1.0
+		);
+		vec4 clip = instMul(prevViewToProj, vec4(corner, 1.0));
+		vec2 uv = (clip.xy / clip.w) * 0.5 + 0.5;
+		uv.y = 1.0 - uv.y;
+		uvMin = min(uvMin, uv);
+		uvMax = max(uvMax, uv);
+	}
+
+	// outside of previous view, no depth to test against
+	if (uvMin.x < 0.0 || uvMin.y < 0.0 || uvMax.x > 1.0 || uvMax.y > 1.0)
+	{
+		return false;
+	}
+
+	// level 0 of pyramid is half resolution
+	ivec2 hizSize = ivec2(u_hizSize);
+	ivec2 texelMin = min(ivec2(uvMin * u_cullDepthSize) / 2, hizSize - 1);
+	ivec2 texelMax = min(ivec2(uvMax * u_cullDepthSize) / 2, hizSize - 1);
+	ivec2 span = texelMax - texelMin;
+	int level = int(ceil(log2(max(float(max(span.x, span.y) ), 1.0) ) ) );
+	level = min(level, int(u_cullHiZMaxLevel) );
+
+	ivec2 levelSize = max(ivec2(hizSize.x >> level, hizSize.y >> level), ivec2(1, 1) );
+	ivec2 levelMin = min(ivec2(texelMin.x >> level, texelMin.y >> level), levelSize - 1);
+	ivec2 levelMax = min(ivec2(texelMax.x >> level, texelMax.y >> level), levelSize - 1);
+	if (levelMax.x - levelMin.x > 1 || levelMax.y - levelMin.y > 1)
+	{
+		// too large for coarsest level
+		return false;
+	}
+
+	float maxDepth = texelFetch(s_hizMax, levelMin, level).x;
+	maxDepth = max(maxDepth, texelFetch(s_hizMax, ivec2(levelMax.x, levelMin.y), level).x);
+	maxDepth = max(maxDepth, texelFetch(s_hizMax, ivec2(levelMin.x, levelMax.y), level).x);
+	maxDepth = max(maxDepth, texelFetch(s_hizMax, levelMax, level).x);
+
+	return nearestDepth > maxDepth;
+}
+
+NUM_THREADS(GROUP_SIZE, 1, 1)
+void main()
+{
+	uint model = gl_GlobalInvocationID.x;
+	if (model >= uint(u_cullModelCount))
+	{
+		return;
+	}
+
+	// count starts of later meshes this model is past
+	float modelIdx = float(model);
+	int mesh = int(dot(step(u_meshInstanceStart, vec4_splat(modelIdx) ), vec4_splat(1.0) ) );
+
+	vec4 instance = b_instances[model];
+	vec4 bounds = u_meshBounds(mesh);
+	vec3 center = bounds.xyz * instance.w + instance.xyz;
+	float radius = bounds.w * instance.w;
+
+	for (int ii = 0; ii < 6; ++ii)
+	{
+		vec4 plane = u_frustumPlane(ii);
+		if (dot(plane.xyz, center) + plane.w < -radius)
+		{
+			return;
+		}
+	}
+
+	if (0.0 < u_useOcclusionCulling && IsOccluded(center, radius) )
+	{
+		return;
+	}
+
+	uint slot;
+	atomicFetchAndAdd(b_meshCounts[mesh], 1u, slot);
+
+	uint meshStart = (0 == mesh) ? 0u : uint(u_meshInstanceStart[mesh - 1]);
+	b_culledInstances[meshStart + slot] = instance;
+}
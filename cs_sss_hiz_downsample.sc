@@ -0,0 +1,60 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "bgfx_compute.sh"
+#include "parameters.sh"
+
+// Build one level of the conservative min and max linear depth pyramids. Level
+// 0 reads full resolution linear depth, later levels read the previous level.
+// When the source has an odd size, the last target texel also covers the extra
+// source row or column, so no depth is dropped. Min is used for tracing, max
+// for occlusion culling.
+
+IMAGE2D_RO(s_source, r16f, 0);
+IMAGE2D_WR(s_target, r16f, 1);
+IMAGE2D_RO(s_sourceMax, r16f, 2);
+IMAGE2D_WR(s_targetMax, r16f, 3);
+
+NUM_THREADS(8, 8, 1)
+void main()
+{
+	ivec2 target = ivec2(gl_GlobalInvocationID.xy);
+	ivec2 sourceSize = ivec2(u_hizSourceSize);
+	ivec2 targetSize = ivec2(u_hizTargetSize);
+
+	if (target.x >= targetSize.x || target.y >= targetSize.y)
+	{
+		return;
+	}
+
+	ivec2 sourceMin = target * 2;
+	ivec2 sourceMax = min(sourceMin + 1, sourceSize - 1);
+	if (target.x == targetSize.x - 1)
+	{
+		sourceMax.x = sourceSize.x - 1;
+	}
+	if (target.y == targetSize.y - 1)
+	{
+		sourceMax.y = sourceSize.y - 1;
+	}
+
+	float minDepth = 1e8;
+	float maxDepth = 0.0;
+	for (int yy = 0; yy < 3; ++yy)
+	{
+		for (int xx = 0; xx < 3; ++xx)
+		{
+			ivec2 source = sourceMin + ivec2(xx, yy);
+			if (source.x <= sourceMax.x && source.y <= sourceMax.y)
+			{
+				minDepth = min(minDepth, imageLoad(s_source, source).x);
+				maxDepth = max(maxDepth, imageLoad(s_sourceMax, source).x);
+			}
+		}
+	}
+
+	imageStore(s_target, target, vec4_splat(minDepth));
+	imageStore(s_targetMax, target, vec4_splat(maxDepth));
+}
@@ -0,0 +1,54 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "linear_depth.sh"
+
+SAMPLER2D(s_shadows, 0);
+SAMPLER2D(s_depth, 1);
+
+// One direction of a separable gaussian over full resolution shadows. Taps
+// whose depth differs from the center are rejected the same way as in the
+// upsample, so shadows don't bleed across silhouettes. Meant to smooth the
+// pattern left by blue noise offsets at low step counts.
+
+#define BLUR_RADIUS			3
+#define DEPTH_WEIGHT_SCALE	256.0
+
+void main()
+{
+	vec2 texCoord = v_texcoord0;
+	float depth = ResolveLinearDepth(texture2D(s_depth, texCoord).x);
+
+	vec2 direction = (0.0 < u_blurVertical)
+		? vec2(0.0, u_screenTexel.y)
+		: vec2(u_screenTexel.x, 0.0);
+
+	vec4 shadow = vec4_splat(0.0);
+	float totalWeight = 0.0;
+	for (int ii = -BLUR_RADIUS; ii <= BLUR_RADIUS; ++ii)
+	{
+		vec2 tapCoord = texCoord + float(ii) * direction;
+		vec4 tapShadow = texture2DLod(s_shadows, tapCoord, 0);
+		float tapDepth = ResolveLinearDepth(texture2DLod(s_depth, tapCoord, 0).x);
+
+		// sigma of half the radius
+		float x = float(ii) / (0.5 * float(BLUR_RADIUS));
+		float gaussianWeight = exp(-0.5 * x * x);
+
+		float depthDelta = abs(tapDepth - depth) / max(depth, 1e-4);
+		float depthWeight = 1.0 / (1.0 + DEPTH_WEIGHT_SCALE * depthDelta);
+
+		float weight = gaussianWeight * depthWeight;
+		shadow += tapShadow * weight;
+		totalWeight += weight;
+	}
+
+	// center tap always has weight 1
+	gl_FragColor = shadow / totalWeight;
+}
@@ -0,0 +1,19 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+
+SAMPLER2D(s_depth, 0);
+
+// depth as is, hardware or linear, into a float target the cpu reference
+// reads back and linearizes itself
+void main()
+{
+	vec2 texCoord = v_texcoord0;
+	float depth = texture2D(s_depth, texCoord).x;
+	gl_FragColor = vec4_splat(depth);
+}
@@ -7,12 +7,93 @@ $input v_texcoord0
 
 #include "../common/common.sh"
 #include "parameters.sh"
+#include "linear_depth.sh"
 #include "normal_encoding.sh"
 
 SAMPLER2D(s_color, 0);
 SAMPLER2D(s_normal, 1);
 SAMPLER2D(s_depth, 2);
 SAMPLER2D(s_shadows, 3);
+SAMPLER2D(s_clusters, 4);
+SAMPLER2D(s_clusterLights, 5);
+SAMPLER2D(s_clusterIndices, 6);
+
+// Must match SSS_CLUSTER_* in sss_cluster.h
+#define CLUSTER_X				16.0
+#define CLUSTER_Y				8.0
+#define CLUSTER_Z				24.0
+#define CLUSTER_MAX_LIGHTS		256.0
+#define CLUSTER_LIGHTS_PER		64
+#define CLUSTER_INDEX_WIDTH		256.0
+#define CLUSTER_INDEX_HEIGHT	64.0
+
+// diffuse and specular from one point light, without shadowing
+float PointLight(vec3 lightPosition, vec3 viewSpacePosition, vec3 vsNormal, float specPower)
+{
+	vec3 light = (lightPosition - viewSpacePosition);
+	float lightDistSq = dot(light, light) + 1e-5;
+	light = normalize(light);
+	float NdotL = saturate(dot(vsNormal, light));
+	float diffuse = NdotL * (1.0/lightDistSq);
+	float specular = 5.0 * pow(NdotL, specPower);
+
+	return mix(diffuse, specular, 0.04);
+}
+
+// Same as PointLight, faded to zero at radius so lights can be culled
+float ClusterPointLight(vec3 lightPosition, float radius, vec3 viewSpacePosition, vec3 vsNormal, float specPower)
+{
+	vec3 light = (lightPosition - viewSpacePosition);
+	float lightDistSq = dot(light, light);
+	float falloff = saturate(1.0 - lightDistSq * lightDistSq / (radius * radius * radius * radius) );
+
+	return PointLight(lightPosition, viewSpacePosition, vsNormal, specPower) * falloff * falloff;
+}
+
+// Lights of the cluster containing this pixel. Light texture rows hold
+// position and radius, color, and a mask selecting the light's channel of
+// shadows, zero for lights that don't cast screen space shadows
+vec3 ClusteredLighting(vec2 texCoord, float linearDepth, vec3 viewSpacePosition, vec3 vsNormal, float specPower, vec4 shadows)
+{
+	vec2 tile = min(floor(texCoord * vec2(CLUSTER_X, CLUSTER_Y) ), vec2(CLUSTER_X, CLUSTER_Y) - 1.0);
+	float slice = clamp(floor(log(linearDepth) * u_clusterDepthScale + u_clusterDepthBias), 0.0, CLUSTER_Z - 1.0);
+	vec2 clusterCoord = vec2(tile.x + tile.y * CLUSTER_X + 0.5, slice + 0.5) / vec2(CLUSTER_X * CLUSTER_Y, CLUSTER_Z);
+	vec2 cluster = texture2DLod(s_clusters, clusterCoord, 0).xy;
+
+	vec3 lighting = vec3_splat(0.0);
+	for (int ii = 0; ii < CLUSTER_LIGHTS_PER; ++ii)
+	{
+		if (cluster.y <= float(ii))
+		{
+			break;
+		}
+
+		float index = cluster.x + float(ii);
+		vec2 indexCoord = vec2(mod(index, CLUSTER_INDEX_WIDTH) + 0.5, floor(index / CLUSTER_INDEX_WIDTH) + 0.5) / vec2(CLUSTER_INDEX_WIDTH, CLUSTER_INDEX_HEIGHT);
+		float light = texture2DLod(s_clusterIndices, indexCoord, 0).x;
+
+		float lightCoord = (light + 0.5) / CLUSTER_MAX_LIGHTS;
+		vec4 positionRadius = texture2DLod(s_clusterLights, vec2(lightCoord, 0.5 / 3.0), 0);
+		vec3 lightColor = texture2DLod(s_clusterLights, vec2(lightCoord, 1.5 / 3.0), 0).xyz;
+		vec4 shadowMask = texture2DLod(s_clusterLights, vec2(lightCoord, 2.5 / 3.0), 0);
+
+		float shadow = 1.0 - dot(shadowMask, vec4_splat(1.0) - shadows);
+		lighting += lightColor * (ClusterPointLight(positionRadius.xyz, positionRadius.w, viewSpacePosition, vsNormal, specPower) * shadow);
+	}
+
+	return lighting;
+}
+
+// Black where nothing was drawn, then blue for one fragment through green
+// and yellow to red at OVERDRAW_MAX or more
+#define OVERDRAW_MAX 8.0
+
+vec3 OverdrawColor(float count)
+{
+	float t = saturate(count / OVERDRAW_MAX);
+	vec3 heat = saturate(vec3(4.0 * t - 2.0, 2.0 - abs(4.0 * t - 2.0), 2.0 - 4.0 * t) );
+	return (0.5 < count) ? heat : vec3_splat(0.0);
+}
 
 // from assao sample, cs_assao_prepare_depths.sc
 vec3 NDCToViewspace( vec2 pos, float viewspaceDepth )
@@ -30,15 +111,15 @@ void main()
 {
 	vec2 texCoord = v_texcoord0;
 
-	vec4 colorId = texture2D(s_color, texCoord);
-	vec3 color = toLinear(colorId.xyz);
-	float materialId = colorId.w;
+	vec4 colorTarget = texture2D(s_color, texCoord);
+	vec3 color = toLinear(colorTarget.xyz);
+	float materialId = GbufferDecodeMaterialId(colorTarget);
 
 	if (0.0 < materialId)
 	{
-		vec4 normalRoughness = texture2D(s_normal, texCoord);
-		vec3 normal = NormalDecode(normalRoughness.xyz);
-		float roughness = normalRoughness.w;
+		vec4 normalTarget = texture2D(s_normal, texCoord);
+		vec3 normal = GbufferDecodeNormal(normalTarget);
+		float roughness = GbufferDecodeRoughness(colorTarget, normalTarget);
 
 		// transform normal into view space
 		mat4 worldToView = mat4(
@@ -50,34 +131,55 @@ void main()
 		vec3 vsNormal = instMul(worldToView, vec4(normal, 0.0)).xyz;
 
 		// read depth and recreate position
-		float linearDepth = texture2D(s_depth, texCoord).x;
+		float linearDepth = ResolveLinearDepth(texture2D(s_depth, texCoord).x);
 		vec3 viewSpacePosition = NDCToViewspace(texCoord, linearDepth);
 
-		float shadow = texture2D(s_shadows, texCoord).x;
+		// one light per channel, unused channels are fully lit
+		vec4 shadows = texture2D(s_shadows, texCoord);
 
 		// need to get a valid view vector for any microfacet stuff :(
 		float gloss = 1.0-roughness;
 		float specPower = 62.0 * gloss + 2.0;
 
-		vec3 light = (u_lightPosition - viewSpacePosition);
-		float lightDistSq = dot(light, light) + 1e-5;
-		light = normalize(light);
-		float NdotL = saturate(dot(vsNormal, light));
-		float diffuse = NdotL * (1.0/lightDistSq);
-		float specular = 5.0 * pow(NdotL, specPower);
-
-		float lightAmount = mix(diffuse, specular, 0.04) * shadow;
+		vec3 lighting;
+		if (0.0 < u_useClusteredLighting)
+		{
+			lighting = ClusteredLighting(texCoord, linearDepth, viewSpacePosition, vsNormal, specPower, shadows);
+		}
+		else
+		{
+			float lightAmount = PointLight(u_lightPosition0, viewSpacePosition, vsNormal, specPower) * shadows.x;
+			if (1.5 < u_lightCount)
+			{
+				lightAmount += PointLight(u_lightPosition1, viewSpacePosition, vsNormal, specPower) * shadows.y;
+			}
+			if (2.5 < u_lightCount)
+			{
+				lightAmount += PointLight(u_lightPosition2, viewSpacePosition, vsNormal, specPower) * shadows.z;
+			}
+			if (3.5 < u_lightCount)
+			{
+				lightAmount += PointLight(u_lightPosition3, viewSpacePosition, vsNormal, specPower) * shadows.w;
+			}
+			lighting = vec3_splat(lightAmount);
+		}
 
-		color = (color * lightAmount);
+		color = (color * lighting);
 		color = toGamma(color);
 
-		// debug display shadows only
-		if (0.0 < u_displayShadows)
+		// debug display shadows only, darkest of all lights
+		if (0.5 < u_displayMode && u_displayMode < 1.5)
 		{
-			color = vec3_splat(shadow);
+			color = vec3_splat(min(min(shadows.x, shadows.y), min(shadows.z, shadows.w)));
 		}
 	}
 	// else, assume color is unlit
 
+	// debug display overdraw, color target holds fragments shaded per pixel
+	if (1.5 < u_displayMode)
+	{
+		color = OverdrawColor(colorTarget.x * 255.0);
+	}
+
 	gl_FragColor = vec4(color, 1.0);
 }
@@ -0,0 +1,12 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+
+// Depth prepass, color writes are masked by state
+void main()
+{
+	gl_FragColor = vec4_splat(0.0);
+}
@@ -0,0 +1,46 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "linear_depth.sh"
+
+SAMPLER2D(s_depth, 0);
+
+// Reduce full resolution linear depth to trace resolution. Alternate between
+// keeping the nearest and farthest depth of each footprint in a checkerboard,
+// so the low resolution buffer keeps both foreground and background surfaces
+// instead of inventing in-between depths along edges.
+
+#define MAX_DOWNSCALE	4
+
+void main()
+{
+	vec2 lowResPixel = floor(gl_FragCoord.xy);
+	vec2 fullResPixel = lowResPixel * u_traceDownscale;
+
+	float minDepth = 1e8;
+	float maxDepth = 0.0;
+	for (int yy = 0; yy < MAX_DOWNSCALE; ++yy)
+	{
+		for (int xx = 0; xx < MAX_DOWNSCALE; ++xx)
+		{
+			if (float(xx) < u_traceDownscale && float(yy) < u_traceDownscale)
+			{
+				vec2 coord = (fullResPixel + vec2(float(xx), float(yy)) + 0.5) * u_screenTexel;
+				float depth = ResolveLinearDepth(texture2DLod(s_depth, coord, 0).x);
+				minDepth = min(minDepth, depth);
+				maxDepth = max(maxDepth, depth);
+			}
+		}
+	}
+
+	float checker = mod(lowResPixel.x + lowResPixel.y, 2.0);
+	float linearDepth = (checker < 0.5) ? minDepth : maxDepth;
+
+	gl_FragColor = vec4_splat(linearDepth);
+}
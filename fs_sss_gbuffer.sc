@@ -55,8 +55,13 @@ void main()
 	float roughness = normalMap.z * mix(0.9, 1.0, albedo.y);
 	roughness = roughness * 0.6 + 0.2;
 
-	vec3 bufferNormal = NormalEncode(bumpedNormal);
+	vec4 colorTarget;
+	vec4 normalTarget;
+	GbufferEncode(toGamma(albedo), bumpedNormal, roughness, 1.0, colorTarget, normalTarget);
 
-	gl_FragData[0] = vec4(toGamma(albedo), 1.0);
-	gl_FragData[1] = vec4(bufferNormal, roughness);
+	gl_FragData[0] = colorTarget;
+	gl_FragData[1] = normalTarget;
+#if defined(SSS_WRITE_LINEAR_DEPTH)
+	gl_FragData[2] = vec4_splat(v_texcoord1.w);
+#endif // defined(SSS_WRITE_LINEAR_DEPTH)
 }
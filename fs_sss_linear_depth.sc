@@ -7,25 +7,10 @@ $input v_texcoord0
 
 #include "../common/common.sh"
 #include "parameters.sh"
+#include "linear_depth.sh"
 
 SAMPLER2D(s_depth, 0);
 
-// from assao sample, cs_assao_prepare_depths.sc
-float ScreenSpaceToViewSpaceDepth( float screenDepth )
-{
-	float depthLinearizeMul = u_depthUnpackConsts.x;
-	float depthLinearizeAdd = u_depthUnpackConsts.y;
-
-	// Optimised version of "-cameraClipNear / (cameraClipFar - projDepth * (cameraClipFar - cameraClipNear)) * cameraClipFar"
-
-	// Set your depthLinearizeMul and depthLinearizeAdd to:
-	// depthLinearizeMul = ( cameraClipFar * cameraClipNear) / ( cameraClipFar - cameraClipNear );
-	// depthLinearizeAdd = cameraClipFar / ( cameraClipFar - cameraClipNear );
-
-	return depthLinearizeMul / ( depthLinearizeAdd - screenDepth );
-}
-
-
 void main()
 {
 	vec2 texCoord = v_texcoord0;
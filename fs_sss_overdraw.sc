@@ -0,0 +1,21 @@
+$input v_normal, v_texcoord0, v_texcoord1
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+
+// Replaces gbuffer shader to count shaded fragments. Color target is blended
+// additively, one unorm8 step per fragment, so it holds count per pixel.
+// Other targets aren't blended, linear depth is still written for passes
+// reading it.
+void main()
+{
+	gl_FragData[0] = vec4_splat(1.0 / 255.0);
+	gl_FragData[1] = vec4_splat(0.0);
+#if defined(SSS_WRITE_LINEAR_DEPTH)
+	gl_FragData[2] = vec4_splat(v_texcoord1.w);
+#endif // defined(SSS_WRITE_LINEAR_DEPTH)
+}
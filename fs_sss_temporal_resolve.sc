@@ -0,0 +1,79 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "linear_depth.sh"
+
+SAMPLER2D(s_shadows, 0);			// this frame's shadows
+SAMPLER2D(s_depth, 1);				// this frame's linear or hardware depth
+SAMPLER2D(s_shadowsHistory, 2);		// previous frame's resolved shadows
+SAMPLER2D(s_depthHistory, 3);		// previous frame's linear depth
+
+// from assao sample, cs_assao_prepare_depths.sc
+vec3 NDCToViewspace( vec2 pos, float viewspaceDepth )
+{
+	vec3 ret;
+
+	ret.xy = (u_ndcToViewMul * pos.xy + u_ndcToViewAdd) * viewspaceDepth;
+
+	ret.z = viewspaceDepth;
+
+	return ret;
+}
+
+void main()
+{
+	vec2 texCoord = v_texcoord0;
+	float linearDepth = ResolveLinearDepth(texture2D(s_depth, texCoord).x);
+	vec4 shadow = texture2D(s_shadows, texCoord);
+
+	// clamp history to range of current neighbourhood, limits ghosting when
+	// light or objects move and shadows change without any disocclusion
+	vec4 neighbourhoodMin = shadow;
+	vec4 neighbourhoodMax = shadow;
+	for (int ii = 0; ii < 4; ++ii)
+	{
+		vec2 offset = (ii < 2)
+			? vec2(float(ii*2 - 1), 0.0)
+			: vec2(0.0, float((ii-2)*2 - 1));
+		vec4 neighbour = texture2DLod(s_shadows, texCoord + offset * u_screenTexel, 0);
+		neighbourhoodMin = min(neighbourhoodMin, neighbour);
+		neighbourhoodMax = max(neighbourhoodMax, neighbour);
+	}
+
+	// find this pixel in previous frame
+	vec3 viewSpacePosition = NDCToViewspace(texCoord, linearDepth);
+	mat4 viewToPrevClip = mat4(
+		u_viewToPrevClip0,
+		u_viewToPrevClip1,
+		u_viewToPrevClip2,
+		u_viewToPrevClip3
+	);
+	vec4 prevClip = instMul(viewToPrevClip, vec4(viewSpacePosition, 1.0));
+	vec2 prevCoord = (prevClip.xy / prevClip.w) * 0.5 + 0.5;
+	prevCoord.y = 1.0 - prevCoord.y;
+
+	bool valid = (0.0 < u_havePrevious)
+		&& (0.0 < prevClip.w)
+		&& (0.0 <= prevCoord.x && prevCoord.x <= 1.0)
+		&& (0.0 <= prevCoord.y && prevCoord.y <= 1.0)
+		;
+
+	// reject history if it saw a different surface, previous clip space w is
+	// view space depth in previous frame
+	float prevDepth = texture2DLod(s_depthHistory, prevCoord, 0).x;
+	valid = valid && (abs(prevDepth - prevClip.w) < u_temporalDepthTolerance * prevClip.w);
+
+	vec4 history = texture2DLod(s_shadowsHistory, prevCoord, 0);
+	history = clamp(history, neighbourhoodMin, neighbourhoodMax);
+
+	vec4 resolved = valid ? mix(history, shadow, u_temporalBlend) : shadow;
+
+	gl_FragData[0] = resolved;
+	gl_FragData[1] = vec4_splat(linearDepth);
+}
@@ -12,10 +12,15 @@ void main()
 	vec3 normal = normalize(v_normal);
 	float roughness = 1.0;
 
-	vec3 bufferNormal = NormalEncode(normal);
+	// write material id 0 to signify different handling while
+	// lighting/shading these pixels in the gbuffer combine pass
+	vec4 colorTarget;
+	vec4 normalTarget;
+	GbufferEncode(toGamma(albedo), normal, roughness, 0.0, colorTarget, normalTarget);
 
-	// write data to alpha channel of color buffer to signify different handling
-	// while lighting/shading these pixels in the gbuffer combine pass
-	gl_FragData[0] = vec4(toGamma(albedo), 0.0);
-	gl_FragData[1] = vec4(bufferNormal, roughness);
+	gl_FragData[0] = colorTarget;
+	gl_FragData[1] = normalTarget;
+#if defined(SSS_WRITE_LINEAR_DEPTH)
+	gl_FragData[2] = vec4_splat(v_texcoord1.w);
+#endif // defined(SSS_WRITE_LINEAR_DEPTH)
 }
@@ -0,0 +1,76 @@
+$input v_texcoord0
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "linear_depth.sh"
+#include "normal_encoding.sh"
+
+SAMPLER2D(s_shadows, 0);		// shadows at trace resolution
+SAMPLER2D(s_depth, 1);			// linear or hardware depth at full resolution
+SAMPLER2D(s_depthLowRes, 2);	// linear depth at trace resolution
+SAMPLER2D(s_normal, 3);			// gbuffer normal at full resolution
+
+// Joint bilateral upsample. Start from bilinear weights of the four nearest
+// trace resolution texels, then reject those whose depth or normal does not
+// match the full resolution pixel, so shadows don't bleed across edges.
+
+#define DEPTH_WEIGHT_SCALE		256.0
+#define NORMAL_WEIGHT_POWER		8.0
+#define MIN_TOTAL_WEIGHT		1e-3
+
+void main()
+{
+	vec2 texCoord = v_texcoord0;
+
+	float depth = ResolveLinearDepth(texture2D(s_depth, texCoord).x);
+	vec3 normal = GbufferDecodeNormal(texture2D(s_normal, texCoord));
+
+	vec2 lowResPosition = texCoord * u_shadowsSize - 0.5;
+	vec2 lowResBase = floor(lowResPosition);
+	vec2 bilinear = lowResPosition - lowResBase;
+
+	vec4 shadow = vec4_splat(0.0);
+	float totalWeight = 0.0;
+
+	// fall back to closest depth match if every tap is rejected
+	vec4 closestShadow = vec4_splat(1.0);
+	float closestDelta = 1e8;
+
+	for (int ii = 0; ii < 4; ++ii)
+	{
+		vec2 offset = vec2(float(ii - (ii/2)*2), float(ii/2));
+		vec2 lowResCoord = (lowResBase + offset + 0.5) / u_shadowsSize;
+
+		// clamp to edge of the part of target shadows were traced into
+		vec2 shadowsCoord = clamp(lowResCoord, 0.5 / u_shadowsSize, 1.0 - 0.5 / u_shadowsSize) * u_shadowsUvScale;
+		vec4 tapShadow = texture2DLod(s_shadows, shadowsCoord, 0);
+		float tapDepth = texture2DLod(s_depthLowRes, lowResCoord, 0).x;
+		vec3 tapNormal = GbufferDecodeNormal(texture2DLod(s_normal, lowResCoord, 0));
+
+		vec2 bilinearWeights = mix(1.0 - bilinear, bilinear, offset);
+		float bilinearWeight = bilinearWeights.x * bilinearWeights.y;
+
+		float depthDelta = abs(tapDepth - depth) / max(depth, 1e-4);
+		float depthWeight = 1.0 / (1.0 + DEPTH_WEIGHT_SCALE * depthDelta);
+		float normalWeight = pow(saturate(dot(normal, tapNormal)), NORMAL_WEIGHT_POWER);
+
+		float weight = bilinearWeight * depthWeight * normalWeight;
+		shadow += tapShadow * weight;
+		totalWeight += weight;
+
+		if (depthDelta < closestDelta)
+		{
+			closestDelta = depthDelta;
+			closestShadow = tapShadow;
+		}
+	}
+
+	shadow = (MIN_TOTAL_WEIGHT < totalWeight) ? (shadow / totalWeight) : closestShadow;
+
+	gl_FragColor = shadow;
+}
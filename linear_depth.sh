@@ -0,0 +1,31 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef LINEAR_DEPTH_SH
+#define LINEAR_DEPTH_SH
+
+// from assao sample, cs_assao_prepare_depths.sc
+float ScreenSpaceToViewSpaceDepth( float screenDepth )
+{
+	float depthLinearizeMul = u_depthUnpackConsts.x;
+	float depthLinearizeAdd = u_depthUnpackConsts.y;
+
+	// Optimised version of "-cameraClipNear / (cameraClipFar - projDepth * (cameraClipFar - cameraClipNear)) * cameraClipFar"
+
+	// Set your depthLinearizeMul and depthLinearizeAdd to:
+	// depthLinearizeMul = ( cameraClipFar * cameraClipNear) / ( cameraClipFar - cameraClipNear );
+	// depthLinearizeAdd = cameraClipFar / ( cameraClipFar - cameraClipNear );
+
+	return depthLinearizeMul / ( depthLinearizeAdd - screenDepth );
+}
+
+// s_depth is either linear depth, or hardware depth when the linear depth
+// pass is skipped and each pass linearizes the depth it reads
+float ResolveLinearDepth( float depth )
+{
+	return (0.0 < u_depthIsHardware) ? ScreenSpaceToViewSpaceDepth(depth) : depth;
+}
+
+#endif // LINEAR_DEPTH_SH
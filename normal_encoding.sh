@@ -89,4 +89,66 @@ vec3 NormalDecode (vec3 normal)
 #endif
 }
 
+// Oct16 (2x8bit normal) for an rg8 target, lower precision than oct24 but
+// a quarter of the bandwidth of an rgba8 target is left unused otherwise
+vec2 NormalEncodeOct16 (vec3 normal) {
+
+	return float32x3_to_oct(normal) * 0.5 + 0.5;
+}
+
+vec3 NormalDecodeOct16 (vec2 normal) {
+
+	return oct_to_float32x3(normal * 2.0 - 1.0);
+}
+
+// Gbuffer layouts, must match GbufferLayout in screen_space_shadows.cpp
+//
+// default: color target has albedo and material id in alpha, normal target
+//   has oct24 normal and roughness in alpha, both rgba8
+// compact (SSS_GBUFFER_COMPACT): color target has albedo, and 6 bits of
+//   roughness above 2 bits of material id in alpha, normal target is rg8
+//   with oct16 normal
+//
+// Material id 0 is unlit, which only needs color and normal.
+
+void GbufferEncode (vec3 color, vec3 normal, float roughness, float materialId, out vec4 colorTarget, out vec4 normalTarget)
+{
+#if defined(SSS_GBUFFER_COMPACT)
+	float roughnessBits = floor(saturate(roughness) * 63.0 + 0.5);
+	colorTarget = vec4(color, (roughnessBits * 4.0 + materialId) / 255.0);
+	normalTarget = vec4(NormalEncodeOct16(normal), 0.0, 0.0);
+#else
+	colorTarget = vec4(color, materialId);
+	normalTarget = vec4(NormalEncode(normal), roughness);
+#endif // defined(SSS_GBUFFER_COMPACT)
+}
+
+vec3 GbufferDecodeNormal (vec4 normalTarget)
+{
+#if defined(SSS_GBUFFER_COMPACT)
+	return NormalDecodeOct16(normalTarget.xy);
+#else
+	return NormalDecode(normalTarget.xyz);
+#endif // defined(SSS_GBUFFER_COMPACT)
+}
+
+float GbufferDecodeMaterialId (vec4 colorTarget)
+{
+#if defined(SSS_GBUFFER_COMPACT)
+	float bits = floor(colorTarget.w * 255.0 + 0.5);
+	return bits - floor(bits / 4.0) * 4.0;
+#else
+	return colorTarget.w;
+#endif // defined(SSS_GBUFFER_COMPACT)
+}
+
+float GbufferDecodeRoughness (vec4 colorTarget, vec4 normalTarget)
+{
+#if defined(SSS_GBUFFER_COMPACT)
+	return floor(floor(colorTarget.w * 255.0 + 0.5) / 4.0) / 63.0;
+#else
+	return normalTarget.w;
+#endif // defined(SSS_GBUFFER_COMPACT)
+}
+
 #endif // NORMAL_ENCODING_SH
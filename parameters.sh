@@ -6,28 +6,93 @@
 #ifndef PARAMETERS_SH
 #define PARAMETERS_SH
 
-uniform vec4 u_params[12];
-
-#define u_frameIdx					(u_params[0].x)
-#define u_shadowRadius				(u_params[0].y)
-#define u_shadowSteps				(u_params[0].z)
-#define u_useNoiseOffset			(u_params[0].w)
-
-#define u_depthUnpackConsts			(u_params[1].xy)
-#define u_contactShadowsMode		(u_params[1].z)
-#define u_useScreenSpaceRadius		(u_params[1].w)
-#define u_ndcToViewMul				(u_params[2].xy)
-#define u_ndcToViewAdd				(u_params[2].zw)
-#define u_lightPosition				(u_params[3].xyz)
-#define u_displayShadows			(u_params[3].w)
-
-#define u_worldToView0				(u_params[4])
-#define u_worldToView1				(u_params[5])
-#define u_worldToView2				(u_params[6])
-#define u_worldToView3				(u_params[7])
-#define u_viewToProj0				(u_params[8])
-#define u_viewToProj1				(u_params[9])
-#define u_viewToProj2				(u_params[10])
-#define u_viewToProj3				(u_params[11])
+// Constant during a frame, uploaded once per frame when contents change
+uniform vec4 u_frameParams[46];
+
+// Changes between passes of a frame
+uniform vec4 u_passParams[2];
+
+#define u_frameIdx					(u_frameParams[0].x)
+#define u_shadowRadius				(u_frameParams[0].y)
+#define u_shadowSteps				(u_frameParams[0].z)
+#define u_useNoiseOffset			(u_frameParams[0].w)
+
+#define u_depthUnpackConsts			(u_frameParams[1].xy)
+#define u_contactShadowsMode		(u_frameParams[1].z)
+#define u_useScreenSpaceRadius		(u_frameParams[1].w)
+#define u_ndcToViewMul				(u_frameParams[2].xy)
+#define u_ndcToViewAdd				(u_frameParams[2].zw)
+#define u_lightCount				(u_frameParams[3].x)
+#define u_useAdaptiveSteps			(u_frameParams[3].y)
+#define u_useBlueNoise				(u_frameParams[3].z)
+#define u_displayMode				(u_frameParams[3].w) // 1 shadows only, 2 overdraw
+
+#define u_worldToView0				(u_frameParams[4])
+#define u_worldToView1				(u_frameParams[5])
+#define u_worldToView2				(u_frameParams[6])
+#define u_worldToView3				(u_frameParams[7])
+#define u_viewToProj0				(u_frameParams[8])
+#define u_viewToProj1				(u_frameParams[9])
+#define u_viewToProj2				(u_frameParams[10])
+#define u_viewToProj3				(u_frameParams[11])
+
+#define u_shadowsSize				(u_frameParams[12].xy)
+#define u_screenTexel				(u_frameParams[12].zw)
+#define u_traceDownscale			(u_frameParams[13].x)
+#define u_hizStepScale				(u_frameParams[13].y)
+#define u_hizMaxLevel				(u_frameParams[13].z)
+#define u_useHiZ					(u_frameParams[13].w)
+#define u_temporalBlend				(u_frameParams[14].x)
+#define u_temporalDepthTolerance	(u_frameParams[14].y)
+#define u_havePrevious				(u_frameParams[14].z)
+#define u_useScreenSpaceMarch		(u_frameParams[14].w)
+
+#define u_viewToPrevClip0			(u_frameParams[15])
+#define u_viewToPrevClip1			(u_frameParams[16])
+#define u_viewToPrevClip2			(u_frameParams[17])
+#define u_viewToPrevClip3			(u_frameParams[18])
+
+// view space light positions, one per channel of shadows
+#define u_lightPosition0			(u_frameParams[19].xyz)
+#define u_lightPosition1			(u_frameParams[20].xyz)
+#define u_lightPosition2			(u_frameParams[21].xyz)
+#define u_lightPosition3			(u_frameParams[22].xyz)
+
+// world space frustum planes, inside when dot(xyz, p) + w >= 0
+#define u_frustumPlane(_idx)		(u_frameParams[23 + (_idx)])
+// first instance of meshes 1 to 4, mesh 0 starts at 0
+#define u_meshInstanceStart			(u_frameParams[29])
+// object space bounding sphere of each mesh, center in xyz, radius in w
+#define u_meshBounds(_mesh)			(u_frameParams[30 + (_mesh)])
+#define u_cullModelCount			(u_frameParams[35].x)
+#define u_useOcclusionCulling		(u_frameParams[35].y)
+#define u_cullHiZMaxLevel			(u_frameParams[35].z)
+#define u_cullDrawCount				(u_frameParams[35].w)
+#define u_hizSize					(u_frameParams[36].xy)
+#define u_cullDepthSize				(u_frameParams[36].zw)
+
+// previous frame's world to view and view to projection, for testing
+// against previous frame's depth pyramid
+#define u_worldToPrevView0			(u_frameParams[37])
+#define u_worldToPrevView1			(u_frameParams[38])
+#define u_worldToPrevView2			(u_frameParams[39])
+#define u_worldToPrevView3			(u_frameParams[40])
+#define u_prevViewToProj0			(u_frameParams[41])
+#define u_prevViewToProj1			(u_frameParams[42])
+#define u_prevViewToProj2			(u_frameParams[43])
+#define u_prevViewToProj3			(u_frameParams[44])
+
+// depth slice of clustered lighting is floor(log(depth) * scale + bias)
+#define u_clusterDepthScale			(u_frameParams[45].x)
+#define u_clusterDepthBias			(u_frameParams[45].y)
+#define u_useClusteredLighting		(u_frameParams[45].z)
+// near plane distance, depth unpack constants swap it with far under reversed z
+#define u_cameraNear				(u_frameParams[45].w)
+
+#define u_hizSourceSize				(u_passParams[0].xy)
+#define u_hizTargetSize				(u_passParams[0].zw)
+#define u_depthIsHardware			(u_passParams[1].x)
+#define u_shadowsUvScale			(u_passParams[1].yz) // part of low res shadows target that was traced into
+#define u_blurVertical				(u_passParams[1].w)
 
 #endif // PARAMETERS_SH
@@ -57,6 +57,292 @@
 *			away. This sample compares the depth difference to the shadow
 *			radius, a 1D distance, instead of comparing the actually
 *			distance in 3D space.
+*
+* compute
+* =======
+* Neighbouring pixels march along nearly parallel rays and fetch mostly the
+* same depth texels. When compute is supported, the shadow pass can run as a
+* compute shader that loads a tile of linear depth into groupshared memory,
+* offset towards the light, and marches every ray in the group against that
+* cache. The fragment shader path remains available for comparison.
+*
+* trace resolution
+* ================
+* Contact shadows are mostly low frequency, so rays can be traced at half or
+* quarter resolution. Linear depth is first reduced, keeping min and max depth
+* in a checkerboard so both sides of an edge survive. Shadows are then
+* upsampled with a joint bilateral filter that compares full resolution depth
+* and normals against each low resolution sample.
+*
+* hi-z
+* ====
+* A fixed number of uniform steps wastes most samples on parts of the ray that
+* are clearly in front of everything. With hi-z traversal, a pyramid of
+* conservative min linear depth is built after the linear depth pass. The
+* march then tries to skip whole spans of steps where the ray stays in front of
+* the minimum depth underneath, and only refines near potential occluders.
+* This makes larger radii and more steps affordable.
+*
+* temporal
+* ========
+* Noise in the initial offset hides banding, but on its own it just turns into
+* visible jitter. With temporal accumulation, each frame's shadows are blended
+* with the previous result, reprojected using last frame's matrices. History
+* is rejected where the previous linear depth does not match, and clamped to
+* the current neighbourhood to limit ghosting. Together with a different
+* offset each frame, far fewer steps per frame give similar quality.
+*
+* specialised shaders
+* ===================
+* The contact shadows mode, radius space and step count are also compiled into
+* the shader as defines, see the makefile for the list of variants. With these
+* known at compile time the linear march has a constant trip count and the
+* accumulators a mode doesn't need are removed, rather than branching on
+* uniforms for every pixel. Specialised shaders are off by default, so the
+* uber-shader stays the baseline, and any step count is available through it.
+* The compare option alternates between both programs and averages gpu time of
+* the shadow pass, so the difference can be measured on the target hardware.
+*
+* linear depth source
+* ===================
+* Shadows, upsample, temporal and combine all read linear depth. By default a
+* full screen pass converts the depth buffer after the gbuffer, which costs a
+* full screen read and write. Instead the gbuffer can write view space depth
+* into an extra render target, or every pass can read the depth buffer and
+* linearize it inline. Hi-z is built from stored linear depth, so it is not
+* available with inline linearization.
+*
+* multiple lights
+* ===============
+* Up to four lights are traced in the same pass, one per channel of the
+* shadows target. View space position, radius and noise are computed once per
+* pixel and shared by all rays, and the compute path shares its cached tile of
+* depth, centered on the tile when there is more than one light. Shadows are
+* an RGBA8 mask, temporal history is kept as RGBA16F so small blend weights
+* still converge.
+*
+* benchmark
+* =========
+* Run with --benchmark to sweep resolution, step count, contact shadows mode
+* and radius space without vsync, with camera and light following a fixed
+* path. Average cpu and gpu time of the gbuffer, linear depth, shadows and
+* combine views are written per configuration to sss_benchmark.csv, or the
+* file given by --benchmark-output. --benchmark-frames sets measured frames
+* per configuration. The app exits when done, and also runs with --noop to
+* track cpu side cost on machines without a gpu.
+*
+* profiler
+* ========
+* The profiler option in the settings window shows min, average and max gpu
+* and cpu time of each pass over the last frames, with a graph of gpu time,
+* along with draw, dispatch and uniform upload counts. Dump snapshot writes
+* current settings and these timings to a text file, to compare settings
+* against a budget.
+*
+* cpu reference
+* =============
+* sss_reference.cpp is a cpu port of the linear march, tracing four pixels at
+* once with bx simd and splitting rows between worker threads. Validate in the
+* settings window reads back depth and shadows of the current frame, runs the
+* reference on the same inputs and reports mean and max error and share of
+* mismatching pixels per light. Depth is copied as the shadows pass samples
+* it, so with the inline depth source the reference linearizes hardware depth
+* itself, for normal and reversed z. Validation is only offered with hi-z off,
+* as the reference has no hi-z traversal. With random offset off, the results
+* should only differ by rounding.
+*
+* tests/sss_reference_test.cpp runs the reference without a gpu over synthetic
+* depth buffers of a ground plane, a box and spheres, in every contact shadows
+* mode, from linear depth as well as from 24 bit and reversed z float hardware
+* depth, and compares the shadows with golden masks in tests/golden.
+* CMakeLists.txt builds it against bx only, set BX_DIR when bx is not next to
+* bgfx, and ctest runs it. Pass --update to write the golden masks again after
+* an intended change to the march.
+*
+* instancing
+* ==========
+* Scene models are sorted by mesh, and their world space position and scale
+* are stored in one static instance buffer. When instancing is supported, the
+* gbuffer pass draws each mesh once with its range of instances, so draw
+* calls, texture binds and uniform uploads no longer grow with model count.
+* The models slider scales the scene up to tens of thousands of props, spread
+* over a larger area, to compare against one draw per model.
+*
+* multithreaded submission
+* ========================
+* Without instancing, every model is its own draw and encoding them becomes
+* the cpu bottleneck at high model counts. With more than one submit thread,
+* models are split into contiguous ranges handed to a small job pool in
+* sss_jobs.cpp, and each thread computes transforms and submits its range
+* through its own encoder from bgfx::begin. Measure submit scaling times model
+* submission for 1, 2, 4 and so on up to the max thread count and lists the
+* speedup over one thread.
+*
+* gpu culling
+* ===========
+* With instancing, a compute pass tests the bounding sphere of every model
+* against the view frustum before the gbuffer. Visible instances are packed
+* into their mesh's range of a second instance buffer and counted per mesh,
+* and a single group pass turns the counts into indexed indirect draws, one
+* per group of each mesh. Optionally models are also tested against previous
+* frame's depth pyramid, which now keeps max depth alongside min depth, so
+* models hidden behind nearer geometry are skipped too. The cpu only submits a
+* fixed number of indirect draws regardless of model count.
+*
+* uniforms
+* ========
+* Uniforms are split into a frame block, constant while a frame is rendered,
+* and a small pass block for values that change between passes like hi-z level
+* sizes. Each block is compared with what was last sent and only uploaded when
+* it changed, since bgfx keeps uniform values until they are set again. The
+* gbuffer view is sequential, so the draw carrying an upload is not sorted
+* after draws relying on it. Submit threads send both blocks once before their
+* first draw. The profiler shows uploads and bytes per frame.
+*
+* gbuffer layout
+* ==============
+* The default gbuffer is two rgba8 targets, albedo with a material id that
+* wastes the whole alpha channel, and oct24 normal with roughness. Combine and
+* upsample are mostly bound by reading these at high resolutions. The compact
+* layout moves roughness into color alpha, 6 bits above a 2 bit material id,
+* and keeps an oct16 normal in an rg8 target, so the gbuffer writes 6 instead
+* of 8 bytes per pixel and unlit pixels still only read color. Albedo needs
+* its own three channels either way, so packing normal, roughness and id into
+* a single 32 bit target would not save a target. Encoding and decoding live
+* in normal_encoding.sh, and shaders touching the gbuffer are built once per
+* layout.
+*
+* reversed z
+* ==========
+* With reversed z the gbuffer renders to a D32F depth buffer with near and far
+* swapped in the projection, cleared to 0 and tested with greater. Float
+* precision then roughly cancels the compression of depth by the perspective
+* divide, instead of piling up near the camera like D24. The same constants
+* linearize it, so combined with the inline depth source every pass samples
+* the depth buffer directly, and the R16F linear depth intermediate with its
+* loss of precision at distance is skipped. With OpenGL's -1 to 1 depth range
+* much of the precision gain is lost.
+*
+* dynamic resolution
+* ==================
+* Shadow cost grows with traced pixels times steps. With dynamic resolution
+* on, gpu time of the shadows view from the last frames is compared against a
+* budget, and the trace viewport shrinks or grows by the square root of the
+* ratio, damped since timings lag a few frames. Optionally steps are reduced
+* too once the viewport reaches its minimum scale, and given back first.
+* Shadows are traced into the top left of their full size target with a
+* smaller view rect, so no render targets are reallocated as the scale
+* changes. While the scale is below one, shadows always go through the depth
+* aware upsample, which scales its coordinates to match, even when tracing at
+* full resolution. Point sampling the smaller rect would stretch each traced
+* pixel over several screen pixels.
+*
+* adaptive steps
+* ==============
+* Short rays, mostly from distant pixels, cross only a few depth texels, and a
+* fixed step count keeps fetching the same ones, including the shaded pixel's
+* own. With adaptive steps the ray end is projected once, and steps are
+* clamped to the number of texels the ray crosses, with the first step pushed
+* at least one texel away from its origin. Hard mode only needs to know
+* whether anything was hit, so both the linear and hi-z march stop at the
+* first hit. Steps change per pixel and light, so the cpu reference does not
+* cover this mode.
+*
+* blue noise
+* ==========
+* White noise offsets clump, leaving patches of banding next to patches of
+* noise. sss_noise.cpp builds a small tiling blue noise texture with void and
+* cluster as the last job of the asset loader, and each frame shifts it by the
+* golden ratio, so offsets stay evenly spread over neighbouring pixels and over
+* consecutive frames. The denoise option then runs a separable gaussian over
+* full resolution shadows before temporal, rejecting taps whose linear depth
+* differs from the center, which smooths what is left of the pattern without
+* bleeding across silhouettes. Blue noise is off by default, and white noise is
+* used until generation finishes. The cpu reference reads the same noise, so
+* validation covers both kinds of offset.
+*
+* render graph
+* ============
+* Passes are declared each frame in sss_graph.cpp's render graph, in
+* submission order and with the targets they read and write. The graph culls
+* passes whose results nothing needs, gives the remaining passes consecutive
+* views, and backs transient targets like linear depth and shadows with render
+* targets from a pool. Transient targets with the same description share a
+* pooled target when their lifetimes don't overlap. For example, denoised
+* shadows take the place of raw shadows, which nothing reads after the first
+* blur. Pooled targets are kept for a while after their last use, so toggling
+* trace resolution or denoise no longer recreates any. Gbuffer, hi-z and
+* history are still owned by the app. While the window is being resized,
+* rendering continues at the previous size and combine stretches the result to
+* the backbuffer. Targets follow once the size has been stable for a few
+* frames, instead of being recreated every frame of the drag.
+*
+* asset loading
+* =============
+* Meshes and ground textures are loaded on a background thread from
+* sss_loader.cpp, so the first frame doesn't wait for them. Jobs run in order,
+* ground and its textures first, and the main thread picks up results of
+* finished jobs at the start of each frame. Until then models of missing
+* meshes are skipped and the ground is drawn with single texel placeholder
+* textures. Blue noise is generated last, it takes tens of milliseconds, which
+* would otherwise delay the first frame. Indirect draws of gpu culling need every mesh, so culling starts
+* once loading is done. Time to first frame and to all assets loaded are
+* written to the debug log. Shader programs are still loaded up front, every
+* pass needs its program before anything can be drawn.
+*
+* baked meshes
+* ============
+* Run with --baked-meshes to draw meshes from a baked format written by
+* sss_mesh.cpp, or with --bake-meshes to write the baked file next to every
+* source mesh and exit. A baked vertex is 16 bytes: position as snorm16
+* relative to the mesh's bounds, oct encoded normal as in normal_encoding.sh
+* in snorm16, and texture coordinates in snorm16. Bounds use one extent for
+* all axes, so dequantizing is a uniform scale and offset folded into each
+* model's transform and instance data, and the gbuffer vertex shaders only
+* differ in unpacking normal and texture coordinates. Baked files are mapped
+* into memory and buffers are created from references into the mapping,
+* without copies or parsing. Baked files record size and modification time of
+* their source mesh. Baked files that are missing, from another format
+* version, or from a source mesh that has changed since are written again from
+* the source mesh when loading, and the rebake is logged. Without the source
+* mesh, the baked file is used as is.
+*
+* overdraw
+* ========
+* Models submitted one by one are sorted front to back by view depth with a
+* radix sort each frame, so depth test rejects hidden fragments before they
+* are shaded. Instanced and gpu culled draws can't be reordered per model, for
+* those the optional depth prepass draws depth only first, and gbuffer then
+* shades only fragments whose depth is equal. Display overdraw additively
+* counts gbuffer fragments per pixel and colors them from blue to red, and
+* with readback the average per pixel and per covered pixel is shown.
+*
+* screen space march
+* ==================
+* The linear march projects every step from view space to find its texel.
+* Screen space march projects only the ray start and end, after pulling the
+* end in front of the near plane, and clips the projected ray where it leaves
+* the screen. Steps are then spaced evenly in texture space, and depth comes
+* from interpolating 1/w, which is linear in screen space, so depth
+* comparisons stay perspective correct. The comparison is multiplied through
+* by 1/w, so steps only multiply, and only hits divide to get back view depth.
+* Hits and distances to blockers are converted back to fractions of the view
+* space ray, so all contact shadow modes behave as with the linear march. Hi-z
+* traversal takes precedence when both are enabled, and the cpu reference does
+* not cover this mode.
+*
+* clustered lighting
+* ==================
+* With clustered lighting, combine shades from a light array instead of the
+* fixed shadow casting lights. The array holds those lights first, followed by
+* up to 252 small point lights whose lighting fades to zero at their radius.
+* sss_cluster.cpp splits the view into 16x8 screen tiles and 24 depth slices
+* spaced exponentially, and each frame assigns every light to the clusters its
+* sphere may touch on the cpu. Cluster offsets and counts, light indices and
+* light data are uploaded as float textures, and combine loops only over the
+* lights of the pixel's cluster. Each light has a mask selecting its channel
+* of screen space shadows. The mask is zero for point lights, so only the
+* lights traced by the shadow pass are shadowed.
 */
 
 
@@ -66,6 +352,19 @@
 #include <imgui/imgui.h>
 #include <bx/rng.h>
 #include <bx/os.h>
+#include <bx/commandline.h>
+#include <bx/file.h>
+#include <bx/allocator.h>
+#include <bx/cpu.h>
+#include <bx/sort.h>
+
+#include "sss_reference.h"
+#include "sss_jobs.h"
+#include "sss_noise.h"
+#include "sss_graph.h"
+#include "sss_loader.h"
+#include "sss_mesh.h"
+#include "sss_cluster.h"
 
 
 namespace {
@@ -73,11 +372,183 @@ namespace {
 // Gbuffer has multiple render targets
 #define GBUFFER_RT_COLOR		0
 #define GBUFFER_RT_NORMAL		1
-#define GBUFFER_RT_DEPTH		2
-#define GBUFFER_RENDER_TARGETS	3
+#define GBUFFER_RT_LINEAR_DEPTH	2
+#define GBUFFER_RT_DEPTH		3
+#define GBUFFER_RENDER_TARGETS	4
+
+#define CAMERA_NEAR				0.01f
+#define CAMERA_FAR				100.0f
 
 #define MODEL_COUNT				100
 
+// Models are grouped by mesh and drawn instanced, keep non instanced
+// fallback below max draw calls per frame
+#define MAX_MODEL_COUNT			32768
+
+// Threads submitting models with their own encoder, including main thread
+#define SUBMIT_MAX_THREADS		32
+
+// Must match GROUP_SIZE in cs_sss_cull_models.sc and cs_sss_cull_draws.sc,
+// which writes all indirect draws in one group
+#define CULL_GROUP_SIZE			64
+#define CULL_MAX_DRAWS			64
+
+// Must match MESH_COUNT in cs_sss_cull_draws.sc, and u_meshBounds rows
+#define CULL_MESH_COUNT			5
+
+// Frames per thread count when measuring submit scaling
+#define SCALING_SETTLE_FRAMES	8
+#define SCALING_FRAMES			32
+
+// One light per channel of shadows target
+#define MAX_LIGHTS				4
+
+// Clustered lighting, shadow casting lights come first in light array
+#define MAX_POINT_LIGHTS		(SSS_CLUSTER_MAX_LIGHTS - MAX_LIGHTS)
+#define SHADOW_LIGHT_RADIUS		20.0f
+#define CLUSTER_NEAR			0.1f
+
+// Must match TILE_SIZE in cs_screen_space_shadows.sc
+#define SHADOWS_TILE_SIZE		8
+
+// Must match NUM_THREADS in cs_sss_hiz_downsample.sc
+#define HIZ_GROUP_SIZE			8
+
+// Coarsest pyramid level used while tracing, level 0 is half resolution
+#define HIZ_MAX_LEVEL			7
+
+// Contact shadows modes, radius spaces and step counts built as specialised
+// shaders, must match SSS_* lists in makefile
+#define SHADOWS_VARIANT_MODES	4
+#define SHADOWS_VARIANT_RADIUS	2
+
+static const int32_t s_shadowStepBuckets[] =
+{
+	4,
+	8,
+	16,
+	32
+};
+
+// Frames spent on each program when comparing against uber-shader, first
+// few are discarded while timer queries for the other program drain
+#define COMPARE_BLOCK_FRAMES	32
+#define COMPARE_SETTLE_FRAMES	8
+
+// Dynamic resolution scales trace viewport, and optionally steps, towards a
+// gpu budget for shadows. Changes are damped since timings lag a few frames
+#define DYNAMIC_SCALE_MIN		0.25f
+#define DYNAMIC_STEPS_MIN		0.25f
+#define DYNAMIC_RATE			0.1f
+#define DYNAMIC_DEADBAND		0.05f
+
+// Where passes after gbuffer read linear depth from
+struct DepthSource
+{
+	enum Enum
+	{
+		LinearPass,		// full screen pass converts hardware depth
+		GbufferTarget,	// gbuffer writes view space depth to extra target
+		HardwareInline,	// each pass linearizes hardware depth it reads
+
+		Count
+	};
+};
+
+// How gbuffer stores albedo, normal, roughness and material id, must match
+// GbufferEncode in normal_encoding.sh
+struct GbufferLayout
+{
+	enum Enum
+	{
+		Default,	// rgba8 albedo and material id, rgba8 oct24 normal and roughness
+		Compact,	// rgba8 albedo, roughness and material id, rg8 oct16 normal
+
+		Count
+	};
+};
+
+// Suffix of shaders built for each layout, see makefile
+static const char* s_gbufferLayoutSuffix[] =
+{
+	"",
+	"_compact"
+};
+BX_STATIC_ASSERT(BX_COUNTOF(s_gbufferLayoutSuffix) == GbufferLayout::Count);
+
+// Benchmark sweeps every resolution, step count bucket, contact shadows mode
+// and radius space. Each configuration renders warmup frames first, so new
+// framebuffers and stats latency don't leak into measured frames
+#define BENCHMARK_WARMUP_FRAMES	16
+#define BENCHMARK_FRAMES		64
+
+static const uint16_t s_benchmarkResolutions[][2] =
+{
+	{ 1280,  720 },
+	{ 1920, 1080 },
+	{ 2560, 1440 }
+};
+
+// Views timed by benchmark, and their csv column names
+struct BenchmarkView
+{
+	const char* m_name;
+	const char* m_column;
+};
+
+static const BenchmarkView s_benchmarkViews[] =
+{
+	{ "gbuffer",              "gbuffer"       },
+	{ "linear depth",         "linear_depth"  },
+	{ "screen space shadows", "shadows"       },
+	{ "combine",              "combine"       }
+};
+
+// Views shown by profiler, in submission order
+static const char * s_profilerViews[] =
+{
+	"cull",
+	"depth prepass",
+	"gbuffer",
+	"linear depth",
+	"hi-z",
+	"downsample depth",
+	"screen space shadows",
+	"upsample shadows",
+	"blur x",
+	"blur y",
+	"temporal",
+	"combine"
+};
+
+#define PROFILER_HISTORY		120
+
+// Threads used by cpu reference when validating gpu shadows
+#define REFERENCE_THREADS		4
+
+// Difference in shadow counted as a mismatch when validating
+#define VALIDATION_MISMATCH		0.25f
+
+// Must match BLUE_NOISE_SIZE in screen_space_shadows.sh
+#define BLUE_NOISE_SIZE			64
+#define BLUE_NOISE_SEED			1337
+
+// Frames window size has to stay the same before render targets follow it
+#define RESIZE_SETTLE_FRAMES	10
+
+// Frames a pooled render target is kept without being used
+#define GRAPH_POOL_MAX_AGE		60
+
+// Render targets are read with point sampling, clamped to edge
+static const uint64_t s_pointSampleFlags = 0
+	| BGFX_TEXTURE_RT
+	| BGFX_SAMPLER_U_CLAMP
+	| BGFX_SAMPLER_V_CLAMP
+	| BGFX_SAMPLER_MIN_POINT
+	| BGFX_SAMPLER_MAG_POINT
+	| BGFX_SAMPLER_MIP_POINT
+	;
+
 static const char * s_meshPaths[] =
 {
 	"meshes/unit_sphere.bin",
@@ -87,6 +558,20 @@ static const char * s_meshPaths[] =
 	"meshes/bunny.bin"
 };
 
+// Ground and its textures are loaded first, then meshes in order
+static const char * s_groundMeshPath = "meshes/cube.bin";
+static const char * s_groundTexturePath = "textures/fieldstone-rgba.dds";
+static const char * s_normalTexturePath = "textures/fieldstone-n.dds";
+
+// Jobs of asset loader, one per asset. Blue noise is generated last, white
+// noise offsets are used until then
+#define LOAD_GROUND				0
+#define LOAD_GROUND_TEXTURE		1
+#define LOAD_NORMAL_TEXTURE		2
+#define LOAD_FIRST_MESH			3
+#define LOAD_BLUE_NOISE			(LOAD_FIRST_MESH + BX_COUNTOF(s_meshPaths) )
+#define LOAD_JOBS				(LOAD_BLUE_NOISE + 1)
+
 static const float s_meshScale[] =
 {
 	0.25f,
@@ -96,6 +581,8 @@ static const float s_meshScale[] =
 	0.25f
 };
 
+BX_STATIC_ASSERT(CULL_MESH_COUNT == BX_COUNTOF(s_meshPaths) );
+
 // Vertex decl for our screen space quad (used in deferred rendering)
 struct PosTexCoord0Vertex
 {
@@ -119,20 +606,70 @@ struct PosTexCoord0Vertex
 
 bgfx::VertexLayout PosTexCoord0Vertex::ms_layout;
 
+// Per instance data of scene models, world space position and uniform scale
+struct InstanceData
+{
+	float m_x;
+	float m_y;
+	float m_z;
+	float m_scale;
+
+	static void init()
+	{
+		ms_layout
+			.begin()
+			.add(bgfx::Attrib::TexCoord7, 4, bgfx::AttribType::Float)
+			.end();
+	}
+
+	static bgfx::VertexLayout ms_layout;
+};
+
+bgfx::VertexLayout InstanceData::ms_layout;
+
 struct Uniforms
 {
-	enum { NumVec4 = 12 };
+	enum { NumFrameVec4 = 46, NumPassVec4 = 2 };
 
 	void init() {
-		u_params = bgfx::createUniform("u_params", bgfx::UniformType::Vec4, NumVec4);
+		u_frameParams = bgfx::createUniform("u_frameParams", bgfx::UniformType::Vec4, NumFrameVec4);
+		u_passParams = bgfx::createUniform("u_passParams", bgfx::UniformType::Vec4, NumPassVec4);
+		m_uploaded = false;
 	};
 
+	// Upload only blocks that changed since last upload, bgfx keeps uniform
+	// values until they are set again. Views with several draws must be
+	// sequential, so the draw carrying an upload isn't sorted after the rest.
 	void submit() const {
-		bgfx::setUniform(u_params, m_params, NumVec4);
+		if (!m_uploaded || 0 != bx::memCmp(m_frameParams, m_uploadedFrameParams, sizeof(m_frameParams) ) )
+		{
+			bgfx::setUniform(u_frameParams, m_frameParams, NumFrameVec4);
+			bx::memCopy(m_uploadedFrameParams, m_frameParams, sizeof(m_frameParams) );
+			++m_submitCount;
+			m_submitBytes += sizeof(m_frameParams);
+		}
+		if (!m_uploaded || 0 != bx::memCmp(m_passParams, m_uploadedPassParams, sizeof(m_passParams) ) )
+		{
+			bgfx::setUniform(u_passParams, m_passParams, NumPassVec4);
+			bx::memCopy(m_uploadedPassParams, m_passParams, sizeof(m_passParams) );
+			++m_submitCount;
+			m_submitBytes += sizeof(m_passParams);
+		}
+		m_uploaded = true;
+	}
+
+	// From submit threads, once before first draw of each thread. Draws of
+	// other encoders may come first, so both blocks are always sent.
+	void submit(bgfx::Encoder* _encoder) const {
+		_encoder->setUniform(u_frameParams, m_frameParams, NumFrameVec4);
+		_encoder->setUniform(u_passParams, m_passParams, NumPassVec4);
+		bx::atomicFetchAndAdd(&m_submitCount, 2u);
+		bx::atomicFetchAndAdd(&m_submitBytes, uint32_t(sizeof(m_frameParams) + sizeof(m_passParams) ) );
 	}
 
 	void destroy() {
-		bgfx::destroy(u_params);
+		bgfx::destroy(u_frameParams);
+		bgfx::destroy(u_passParams);
 	}
 
 	union
@@ -142,33 +679,158 @@ struct Uniforms
 			/* 0    */ struct { float m_frameIdx; float m_shadowRadius; float m_shadowSteps; float m_useNoiseOffset; };
 			/* 1    */ struct { float m_depthUnpackConsts[2]; float m_contactShadowsMode; float m_useScreenSpaceRadius; };
 			/* 2    */ struct { float m_ndcToViewMul[2]; float m_ndcToViewAdd[2]; };
-			/* 3    */ struct { float m_lightPosition[3]; float m_displayShadows; };
+			/* 3    */ struct { float m_lightCount; float m_useAdaptiveSteps; float m_useBlueNoise; float m_displayMode; };
 			/* 4-7  */ struct { float m_worldToView[16]; }; // built-in u_view will be transform for quad during screen passes
 			/* 8-11 */ struct { float m_viewToProj[16]; };	 // built-in u_proj will be transform for quad during screen passes
+			/* 12   */ struct { float m_shadowsSize[2]; float m_screenTexel[2]; };
+			/* 13   */ struct { float m_traceDownscale; float m_hizStepScale; float m_hizMaxLevel; float m_useHiZ; };
+			/* 14   */ struct { float m_temporalBlend; float m_temporalDepthTolerance; float m_havePrevious; float m_useScreenSpaceMarch; };
+			/* 15-18 */ struct { float m_viewToPrevClip[16]; }; // current view space to previous frame's clip space
+			/* 19-22 */ struct { float m_lightPosition[MAX_LIGHTS][4]; }; // view space, w unused
+			/* 23-28 */ struct { float m_frustumPlanes[6][4]; }; // world space, inside when dot(xyz, p) + w >= 0
+			/* 29    */ struct { float m_meshInstanceStart[4]; }; // meshes 1 to 4, mesh 0 starts at 0
+			/* 30-34 */ struct { float m_meshBounds[CULL_MESH_COUNT][4]; }; // object space bounding sphere
+			/* 35    */ struct { float m_cullModelCount; float m_useOcclusionCulling; float m_cullHiZMaxLevel; float m_cullDrawCount; };
+			/* 36    */ struct { float m_hizSize[2]; float m_cullDepthSize[2]; }; // hi-z level 0 size, shared by tracing and culling
+			/* 37-40 */ struct { float m_worldToPrevView[16]; };
+			/* 41-44 */ struct { float m_prevViewToProj[16]; };
+			/* 45    */ struct { float m_clusterDepthScale; float m_clusterDepthBias; float m_useClusteredLighting; float m_cameraNear; };
+		};
+
+		float m_frameParams[NumFrameVec4 * 4];
+	};
+
+	union
+	{
+		struct
+		{
+			/* 0    */ struct { float m_hizSourceSize[2]; float m_hizTargetSize[2]; };
+			/* 1    */ struct { float m_depthIsHardware; float m_shadowsUvScale[2]; float m_blurVertical; };
 		};
 
-		float m_params[NumVec4 * 4];
+		float m_passParams[NumPassVec4 * 4];
 	};
 
-	bgfx::UniformHandle u_params;
+	bgfx::UniformHandle u_frameParams;
+	bgfx::UniformHandle u_passParams;
+
+	// last values sent to bgfx from main thread
+	mutable float m_uploadedFrameParams[NumFrameVec4 * 4];
+	mutable float m_uploadedPassParams[NumPassVec4 * 4];
+	mutable bool m_uploaded = false;
+
+	// uploads and bytes since app last reset them, reported by profiler
+	mutable uint32_t m_submitCount = 0;
+	mutable uint32_t m_submitBytes = 0;
+};
+
+// Rolling window of one view's timings, for profiler
+struct ProfilerView
+{
+	void push(float _gpuMs, float _cpuMs)
+	{
+		m_gpu[m_offset] = _gpuMs;
+		m_cpu[m_offset] = _cpuMs;
+		m_offset = (m_offset + 1) % PROFILER_HISTORY;
+		m_count = bx::min(m_count + 1, uint32_t(PROFILER_HISTORY) );
+	}
+
+	// first value for plotting, window starts at 0 until it wraps
+	int32_t plotOffset() const
+	{
+		return m_count < PROFILER_HISTORY ? 0 : int32_t(m_offset);
+	}
+
+	static void summary(const float* _values, uint32_t _count, float& _min, float& _avg, float& _max)
+	{
+		_min = 0.0f;
+		_avg = 0.0f;
+		_max = 0.0f;
+		if (0 == _count)
+		{
+			return;
+		}
+
+		_min = _values[0];
+		_max = _values[0];
+		float sum = 0.0f;
+		for (uint32_t ii = 0; ii < _count; ++ii)
+		{
+			_min = bx::min(_min, _values[ii]);
+			_max = bx::max(_max, _values[ii]);
+			sum += _values[ii];
+		}
+		_avg = sum / float(_count);
+	}
+
+	float m_gpu[PROFILER_HISTORY];
+	float m_cpu[PROFILER_HISTORY];
+	uint32_t m_count = 0;
+	uint32_t m_offset = 0;
+	bool m_active = false; // submitted in last frame
+};
+
+// Render graph passes declared this frame, SSS_GRAPH_INVALID when disabled
+struct GraphPasses
+{
+	uint16_t m_cull;
+	uint16_t m_depthPrepass;
+	uint16_t m_gbuffer;
+	uint16_t m_overdrawReadback;
+	uint16_t m_linearDepth;
+	uint16_t m_hiz;
+	uint16_t m_downsampleDepth;
+	uint16_t m_shadows;
+	uint16_t m_upsampleShadows;
+	uint16_t m_copyDepth;
+	uint16_t m_readback;
+	uint16_t m_blurX;
+	uint16_t m_blurY;
+	uint16_t m_temporal;
+	uint16_t m_combine;
+};
+
+// Render graph targets declared this frame, SSS_GRAPH_INVALID when unused
+struct GraphTargets
+{
+	uint16_t m_gbuffer;
+	uint16_t m_indirect;
+	uint16_t m_depth;
+	uint16_t m_hiz;
+	uint16_t m_linearDepthLowRes;
+	uint16_t m_shadowsLowRes;
+	uint16_t m_shadows;
+	uint16_t m_readbackDepth;
+	uint16_t m_shadowsBlur;
+	uint16_t m_shadowsDenoised;
+	uint16_t m_resolvedShadows; // input of temporal and combine
+	uint16_t m_history;
+	uint16_t m_prevHistory;
+	uint16_t m_backbuffer;
 };
 
-struct RenderTarget
+// Resolved shadows and the linear depth they were resolved against, so next
+// frame can detect disocclusion. Shadows are kept at higher precision than
+// the traced mask, so small blend weights still converge
+struct HistoryTarget
 {
-	void init(uint32_t _width, uint32_t _height, bgfx::TextureFormat::Enum _format, uint64_t _flags)
+	void init(uint32_t _width, uint32_t _height, uint64_t _flags)
 	{
-		m_texture = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, _format, _flags);
+		m_shadows = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, bgfx::TextureFormat::RGBA16F, _flags);
+		m_depth = bgfx::createTexture2D(uint16_t(_width), uint16_t(_height), false, 1, bgfx::TextureFormat::R16F, _flags);
+		bgfx::TextureHandle textures[] = { m_shadows, m_depth };
 		const bool destroyTextures = true;
-		m_buffer = bgfx::createFrameBuffer(1, &m_texture, destroyTextures);
+		m_buffer = bgfx::createFrameBuffer(BX_COUNTOF(textures), textures, destroyTextures);
 	}
 
 	void destroy()
 	{
-		// also responsible for destroying texture
+		// also responsible for destroying textures
 		bgfx::destroy(m_buffer);
 	}
 
-	bgfx::TextureHandle m_texture;
+	bgfx::TextureHandle m_shadows;
+	bgfx::TextureHandle m_depth;
 	bgfx::FrameBufferHandle m_buffer;
 };
 
@@ -249,6 +911,23 @@ void mat4Set(float * _m, const float * _src)
 	}
 }
 
+// Same as meshSubmit from bgfx_utils, through _encoder
+void meshSubmit(bgfx::Encoder* _encoder, const Mesh* _mesh, bgfx::ViewId _id, bgfx::ProgramHandle _program, const float* _mtx, uint64_t _state)
+{
+	_encoder->setTransform(_mtx);
+	_encoder->setState(_state);
+
+	for (GroupArray::const_iterator it = _mesh->m_groups.begin(), itEnd = _mesh->m_groups.end(); it != itEnd; ++it)
+	{
+		const Group& group = *it;
+		_encoder->setIndexBuffer(group.m_ibh);
+		_encoder->setVertexBuffer(0, group.m_vbh);
+		_encoder->submit(_id, _program, 0, BGFX_DISCARD_INDEX_BUFFER | BGFX_DISCARD_VERTEX_STREAMS);
+	}
+
+	_encoder->discard();
+}
+
 class ExampleScreenSpaceShadows : public entry::AppI
 {
 public:
@@ -261,12 +940,29 @@ public:
 
 	void init(int32_t _argc, const char* const* _argv, uint32_t _width, uint32_t _height) override
 	{
+		m_initTime = bx::getHPCounter();
+
 		Args args(_argc, _argv);
 
+		// --benchmark [--benchmark-output <file.csv>] [--benchmark-frames <n>]
+		bx::CommandLine cmdLine(_argc, _argv);
+		m_benchmark = cmdLine.hasArg("benchmark");
+		int32_t benchmarkFrames;
+		if (cmdLine.hasArg(benchmarkFrames, '\0', "benchmark-frames") )
+		{
+			m_benchmarkFrames = uint32_t(bx::max(benchmarkFrames, 1) );
+		}
+
+		// --baked-meshes draws meshes from baked files, --bake-meshes writes
+		// them and exits
+		m_bakeMeshes = cmdLine.hasArg("bake-meshes");
+		m_useBakedMeshes = m_bakeMeshes || cmdLine.hasArg("baked-meshes");
+
 		m_width = _width;
 		m_height = _height;
 		m_debug = BGFX_DEBUG_NONE;
-		m_reset = BGFX_RESET_VSYNC;
+		// vsync would hide real cost while benchmarking
+		m_reset = m_benchmark ? BGFX_RESET_NONE : BGFX_RESET_VSYNC;
 
 		bgfx::Init init;
 		init.type = args.m_type;
@@ -275,11 +971,17 @@ public:
 		init.resolution.width = m_width;
 		init.resolution.height = m_height;
 		init.resolution.reset = m_reset;
+		// Main thread and every submit thread need own encoder
+		init.limits.maxEncoders = SUBMIT_MAX_THREADS + 1;
 		bgfx::init(init);
 
 		// Enable debug text.
 		bgfx::setDebug(m_debug);
 
+		// Gbuffer clears linear depth target to far plane, other targets to zero
+		bgfx::setPaletteColor(0, 0.0f, 0.0f, 0.0f, 0.0f);
+		bgfx::setPaletteColor(1, CAMERA_FAR, CAMERA_FAR, CAMERA_FAR, CAMERA_FAR);
+
 		// Create uniforms
 		m_uniforms.init();
 
@@ -289,40 +991,187 @@ public:
 		s_normal = bgfx::createUniform("s_normal", bgfx::UniformType::Sampler); // Normal gbuffer, Model's source normal
 		s_depth = bgfx::createUniform("s_depth", bgfx::UniformType::Sampler); // Depth gbuffer
 		s_shadows = bgfx::createUniform("s_shadows", bgfx::UniformType::Sampler);
-
-		// Create program from shaders.
-		m_gbufferProgram = loadProgram("vs_sss_gbuffer", "fs_sss_gbuffer"); // Fill gbuffer
-		m_sphereProgram = loadProgram("vs_sss_gbuffer", "fs_sss_unlit");
+		s_depthLowRes = bgfx::createUniform("s_depthLowRes", bgfx::UniformType::Sampler); // Linear depth at trace resolution
+		s_hiz = bgfx::createUniform("s_hiz", bgfx::UniformType::Sampler); // Min linear depth pyramid
+		s_hizMax = bgfx::createUniform("s_hizMax", bgfx::UniformType::Sampler); // Max linear depth pyramid
+		s_shadowsHistory = bgfx::createUniform("s_shadowsHistory", bgfx::UniformType::Sampler); // Previous frame's resolved shadows
+		s_depthHistory = bgfx::createUniform("s_depthHistory", bgfx::UniformType::Sampler); // Previous frame's linear depth
+		s_blueNoise = bgfx::createUniform("s_blueNoise", bgfx::UniformType::Sampler); // Tiling blue noise for initial offset
+		s_clusters = bgfx::createUniform("s_clusters", bgfx::UniformType::Sampler); // Offset and count of each cluster's lights
+		s_clusterLights = bgfx::createUniform("s_clusterLights", bgfx::UniformType::Sampler); // Lights of clustered lighting
+		s_clusterIndices = bgfx::createUniform("s_clusterIndices", bgfx::UniformType::Sampler); // Light indices of all clusters
+
+		// Create program from shaders. Baked meshes have own vertex layout
+		const char* vsGbuffer = m_useBakedMeshes ? "vs_sss_gbuffer_baked" : "vs_sss_gbuffer";
+		const char* vsGbufferInstanced = m_useBakedMeshes ? "vs_sss_gbuffer_instanced_baked" : "vs_sss_gbuffer_instanced";
+		for (int32_t ii = 0; ii < GbufferLayout::Count; ++ii)
+		{
+			m_gbufferProgram[ii] = loadGbufferProgram(vsGbuffer, "fs_sss_gbuffer", ii); // Fill gbuffer
+			m_sphereProgram[ii] = loadGbufferProgram(vsGbuffer, "fs_sss_unlit", ii);
+			m_gbufferLinearDepthProgram[ii] = loadGbufferProgram(vsGbuffer, "fs_sss_gbuffer_linear_depth", ii); // Also write linear depth
+			m_sphereLinearDepthProgram[ii] = loadGbufferProgram(vsGbuffer, "fs_sss_unlit_linear_depth", ii);
+			m_gbufferInstancedProgram[ii] = loadGbufferProgram(vsGbufferInstanced, "fs_sss_gbuffer", ii);
+			m_gbufferInstancedLinearDepthProgram[ii] = loadGbufferProgram(vsGbufferInstanced, "fs_sss_gbuffer_linear_depth", ii);
+			m_combineProgram[ii] = loadGbufferProgram("vs_sss_screenquad", "fs_sss_deferred_combine", ii); // Compute lighting from gbuffer
+			m_upsampleShadowsProgram[ii] = loadGbufferProgram("vs_sss_screenquad", "fs_sss_upsample_shadows", ii);
+		}
 		m_linearDepthProgram = loadProgram("vs_sss_screenquad", "fs_sss_linear_depth");
+		m_copyDepthProgram = loadProgram("vs_sss_screenquad", "fs_sss_copy_depth");
 		m_shadowsProgram = loadProgram("vs_sss_screenquad", "fs_screen_space_shadows");
-		m_combineProgram = loadProgram("vs_sss_screenquad", "fs_sss_deferred_combine"); // Compute lighting from gbuffer
+		m_downsampleDepthProgram = loadProgram("vs_sss_screenquad", "fs_sss_downsample_depth");
+		m_temporalProgram = loadProgram("vs_sss_screenquad", "fs_sss_temporal_resolve");
+		m_blurShadowsProgram = loadProgram("vs_sss_screenquad", "fs_sss_blur_shadows");
+		m_depthPrepassProgram = loadProgram(vsGbuffer, "fs_sss_depth");
+		m_depthPrepassInstancedProgram = loadProgram(vsGbufferInstanced, "fs_sss_depth");
+		m_overdrawProgram = loadProgram(vsGbuffer, "fs_sss_overdraw");
+		m_overdrawLinearDepthProgram = loadProgram(vsGbuffer, "fs_sss_overdraw_linear_depth");
+		m_overdrawInstancedProgram = loadProgram(vsGbufferInstanced, "fs_sss_overdraw");
+		m_overdrawInstancedLinearDepthProgram = loadProgram(vsGbufferInstanced, "fs_sss_overdraw_linear_depth");
+
+		// Compute path for shadows is optional, keep fragment path for comparison
+		m_computeSupported = 0 != (bgfx::getCaps()->supported & BGFX_CAPS_COMPUTE);
+		m_instancingSupported = 0 != (bgfx::getCaps()->supported & BGFX_CAPS_INSTANCING);
+		m_useInstancing = m_instancingSupported;
+
+		// Compact gbuffer renders normals to rg8
+		m_compactGbufferSupported = 0 != (bgfx::getCaps()->formats[bgfx::TextureFormat::RG8] & BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER);
+
+		// Overdraw display blends color target only, when gbuffer also writes
+		// linear depth
+		m_blendIndependentSupported = 0 != (bgfx::getCaps()->supported & BGFX_CAPS_BLEND_INDEPENDENT);
+
+		// Clusters and lights are read from float textures, updated every frame
+		m_clusteredSupported = 0 != (bgfx::getCaps()->formats[bgfx::TextureFormat::RG32F] & BGFX_CAPS_FORMAT_TEXTURE_2D)
+			&& 0 != (bgfx::getCaps()->formats[bgfx::TextureFormat::R32F] & BGFX_CAPS_FORMAT_TEXTURE_2D)
+			&& 0 != (bgfx::getCaps()->formats[bgfx::TextureFormat::RGBA32F] & BGFX_CAPS_FORMAT_TEXTURE_2D)
+			;
+
+		// Reversed z renders to float depth
+		m_reversedZSupported = 0 != (bgfx::getCaps()->formats[bgfx::TextureFormat::D32F] & BGFX_CAPS_FORMAT_TEXTURE_FRAMEBUFFER);
+
+		// Encoders may be limited when bgfx is built single threaded
+		m_maxSubmitThreads = bx::min(uint32_t(SUBMIT_MAX_THREADS), uint32_t(bgfx::getCaps()->limits.maxEncoders) - 1);
+		if (1 < m_maxSubmitThreads)
+		{
+			m_jobs.init(m_maxSubmitThreads - 1);
+		}
+
+		m_shadowsComputeProgram = BGFX_INVALID_HANDLE;
+		m_hizProgram = BGFX_INVALID_HANDLE;
+		if (m_computeSupported)
+		{
+			m_shadowsComputeProgram = loadProgram("cs_screen_space_shadows", NULL);
+			m_hizProgram = loadProgram("cs_sss_hiz_downsample", NULL);
+		}
+		m_useComputeShadows = m_computeSupported;
+
+		// Culling writes instances and indirect draws for instanced gbuffer
+		m_cullingSupported = m_computeSupported
+			&& m_instancingSupported
+			&& 0 != (bgfx::getCaps()->supported & BGFX_CAPS_DRAW_INDIRECT)
+			;
+		m_useCulling = m_cullingSupported;
+		m_cullModelsProgram = BGFX_INVALID_HANDLE;
+		m_cullDrawsProgram = BGFX_INVALID_HANDLE;
+		if (m_cullingSupported)
+		{
+			m_cullModelsProgram = loadProgram("cs_sss_cull_models", NULL);
+			m_cullDrawsProgram = loadProgram("cs_sss_cull_draws", NULL);
+		}
+
+		// Validation copies depth and shadows back to cpu
+		m_readbackSupported = BGFX_CAPS_TEXTURE_BLIT == (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_BLIT)
+			&& BGFX_CAPS_TEXTURE_READ_BACK == (bgfx::getCaps()->supported & BGFX_CAPS_TEXTURE_READ_BACK)
+			;
+
+		if (m_benchmark)
+		{
+			const char* benchmarkOutput = cmdLine.findOption("benchmark-output", "sss_benchmark.csv");
+			m_benchmark = beginBenchmark(benchmarkOutput);
+		}
+
+		// Specialised shadow programs are loaded on first use
+		for (uint32_t mode = 0; mode < SHADOWS_VARIANT_MODES; ++mode)
+		{
+			for (uint32_t radius = 0; radius < SHADOWS_VARIANT_RADIUS; ++radius)
+			{
+				for (uint32_t steps = 0; steps < BX_COUNTOF(s_shadowStepBuckets); ++steps)
+				{
+					m_shadowsVariants[mode][radius][steps] = BGFX_INVALID_HANDLE;
+					m_shadowsComputeVariants[mode][radius][steps] = BGFX_INVALID_HANDLE;
+				}
+			}
+		}
 
-		// Load some meshes
+		// Meshes are loaded in background, models of missing meshes are skipped
+		sss::bakedMeshInit();
 		for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
 		{
-			m_meshes[ii] = meshLoad(s_meshPaths[ii]);
+			m_meshes[ii] = NULL;
+			m_loadedMeshes[ii] = NULL;
+			vec4Set(m_meshDequantize[ii], 0.0f, 0.0f, 0.0f, 1.0f);
+		}
+		vec4Set(m_groundDequantize, 0.0f, 0.0f, 0.0f, 1.0f);
+
+		if (m_bakeMeshes)
+		{
+			bakeMeshes();
 		}
 
 		// sphere is first mesh
-		m_lightModel.mesh = 0;
+		for (uint32_t ii = 0; ii < MAX_LIGHTS; ++ii)
+		{
+			m_lightModels[ii].mesh = 0;
+		}
 
 		// Randomly create some models
-		bx::RngMwc mwc;
-		for (uint32_t ii = 0; ii < BX_COUNTOF(m_models); ++ii)
+		InstanceData::init();
+		m_drawInfo = BGFX_INVALID_HANDLE;
+		m_models = (Model*)BX_ALLOC(entry::getAllocator(), MAX_MODEL_COUNT * sizeof(Model) );
+		m_modelOrder = (uint32_t*)BX_ALLOC(entry::getAllocator(), MAX_MODEL_COUNT * 4 * sizeof(uint32_t) );
+		m_sortTempOrder = m_modelOrder + MAX_MODEL_COUNT;
+		m_sortKeys = m_sortTempOrder + MAX_MODEL_COUNT;
+		m_sortTempKeys = m_sortKeys + MAX_MODEL_COUNT;
+		m_instanceBuffer = BGFX_INVALID_HANDLE;
+		createModels();
+
+		// Ground is the cube. Until its textures are loaded, draw with a
+		// single texel of average albedo and flat normal
+		m_ground = NULL;
+		m_loadedGround = NULL;
 		{
-			Model& model = m_models[ii];
-
-			model.mesh = mwc.gen() % BX_COUNTOF(s_meshPaths);
-			model.position[0] = (((mwc.gen() % 256)) - 128.0f) / 20.0f;
-			model.position[1] = 0;
-			model.position[2] = (((mwc.gen() % 256)) - 128.0f) / 20.0f;
+			const uint8_t albedo[4] = { 128, 128, 128, 255 };
+			const uint8_t normal[4] = { 128, 128, 255, 255 };
+			m_groundTexture = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_NONE, bgfx::copy(albedo, sizeof(albedo) ) );
+			m_normalTexture = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::RGBA8, BGFX_TEXTURE_NONE, bgfx::copy(normal, sizeof(normal) ) );
+			m_loadedGroundTexture = BGFX_INVALID_HANDLE;
+			m_loadedNormalTexture = BGFX_INVALID_HANDLE;
 		}
 
-		// Load ground, just use the cube
-		m_ground = meshLoad("meshes/cube.bin");
-
-		m_groundTexture = loadTexture("textures/fieldstone-rgba.dds");
-		m_normalTexture = loadTexture("textures/fieldstone-n.dds");
+		// Blue noise takes a while to generate, shadows bind a single texel
+		// until it is done and keep using white noise offsets
+		{
+			const uint8_t noise = 0;
+			m_blueNoiseTexture = bgfx::createTexture2D(1, 1, false, 1, bgfx::TextureFormat::R8, BGFX_SAMPLER_POINT, bgfx::copy(&noise, sizeof(noise) ) );
+			m_loadedBlueNoiseTexture = BGFX_INVALID_HANDLE;
+			m_blueNoiseLoaded = false;
+		}
+		m_numLoaded = 0;
+		m_loader.start(loadAssetJob, this, LOAD_JOBS);
+
+		// Light lists of clustered lighting, rebuilt on cpu every frame
+		m_clusterData = (float*)BX_ALLOC(entry::getAllocator(), (SSS_CLUSTER_COUNT * 2 + SSS_CLUSTER_MAX_INDICES + SSS_CLUSTER_MAX_LIGHTS * 3 * 4) * sizeof(float) );
+		m_clusterIndices = m_clusterData + SSS_CLUSTER_COUNT * 2;
+		m_clusterLightData = m_clusterIndices + SSS_CLUSTER_MAX_INDICES;
+		m_clusterTexture = BGFX_INVALID_HANDLE;
+		m_clusterLightTexture = BGFX_INVALID_HANDLE;
+		m_clusterIndexTexture = BGFX_INVALID_HANDLE;
+		if (m_clusteredSupported)
+		{
+			m_clusterTexture = bgfx::createTexture2D(SSS_CLUSTER_X * SSS_CLUSTER_Y, SSS_CLUSTER_Z, false, 1, bgfx::TextureFormat::RG32F, BGFX_SAMPLER_POINT);
+			m_clusterLightTexture = bgfx::createTexture2D(SSS_CLUSTER_MAX_LIGHTS, 3, false, 1, bgfx::TextureFormat::RGBA32F, BGFX_SAMPLER_POINT);
+			m_clusterIndexTexture = bgfx::createTexture2D(SSS_CLUSTER_INDEX_WIDTH, SSS_CLUSTER_MAX_INDICES / SSS_CLUSTER_INDEX_WIDTH, false, 1, bgfx::TextureFormat::R32F, BGFX_SAMPLER_POINT);
+		}
 
 		m_recreateFrameBuffers = false;
 		createFramebuffers();
@@ -338,6 +1187,8 @@ public:
 
 		cameraGetViewMtx(m_view);
 		bx::mtxProj(m_proj, m_fovY, float(m_size[0]) / float(m_size[1]), 0.01f, 100.0f,  bgfx::getCaps()->homogeneousDepth);
+		mat4Set(m_prevView, m_view);
+		mat4Set(m_prevProj, m_proj);
 
 		// Track whether previous results are valid
 		m_havePrevious = false;
@@ -351,20 +1202,102 @@ public:
 
 	int32_t shutdown() override
 	{
+		// take whatever finished loading, so it can be unloaded
+		m_loader.shutdown();
+		updateLoading();
 		for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
 		{
-			meshUnload(m_meshes[ii]);
+			if (NULL != m_meshes[ii])
+			{
+				meshUnload(m_meshes[ii]);
+			}
+		}
+		if (NULL != m_ground)
+		{
+			meshUnload(m_ground);
+		}
+
+		m_jobs.shutdown();
+
+		bgfx::destroy(m_instanceBuffer);
+		BX_FREE(entry::getAllocator(), m_models);
+		BX_FREE(entry::getAllocator(), m_modelOrder);
+		if (NULL != m_overdrawData)
+		{
+			BX_FREE(entry::getAllocator(), m_overdrawData);
 		}
-		meshUnload(m_ground);
 
 		bgfx::destroy(m_normalTexture);
 		bgfx::destroy(m_groundTexture);
+		bgfx::destroy(m_blueNoiseTexture);
+		if (m_clusteredSupported)
+		{
+			bgfx::destroy(m_clusterTexture);
+			bgfx::destroy(m_clusterLightTexture);
+			bgfx::destroy(m_clusterIndexTexture);
+		}
+		BX_FREE(entry::getAllocator(), m_clusterData);
 
-		bgfx::destroy(m_gbufferProgram);
-		bgfx::destroy(m_sphereProgram);
+		for (int32_t ii = 0; ii < GbufferLayout::Count; ++ii)
+		{
+			bgfx::destroy(m_gbufferProgram[ii]);
+			bgfx::destroy(m_sphereProgram[ii]);
+			bgfx::destroy(m_gbufferLinearDepthProgram[ii]);
+			bgfx::destroy(m_sphereLinearDepthProgram[ii]);
+			bgfx::destroy(m_gbufferInstancedProgram[ii]);
+			bgfx::destroy(m_gbufferInstancedLinearDepthProgram[ii]);
+			bgfx::destroy(m_combineProgram[ii]);
+			bgfx::destroy(m_upsampleShadowsProgram[ii]);
+		}
 		bgfx::destroy(m_linearDepthProgram);
+		bgfx::destroy(m_copyDepthProgram);
 		bgfx::destroy(m_shadowsProgram);
-		bgfx::destroy(m_combineProgram);
+		bgfx::destroy(m_downsampleDepthProgram);
+		bgfx::destroy(m_temporalProgram);
+		bgfx::destroy(m_blurShadowsProgram);
+		bgfx::destroy(m_depthPrepassProgram);
+		bgfx::destroy(m_depthPrepassInstancedProgram);
+		bgfx::destroy(m_overdrawProgram);
+		bgfx::destroy(m_overdrawLinearDepthProgram);
+		bgfx::destroy(m_overdrawInstancedProgram);
+		bgfx::destroy(m_overdrawInstancedLinearDepthProgram);
+		if (bgfx::isValid(m_shadowsComputeProgram))
+		{
+			bgfx::destroy(m_shadowsComputeProgram);
+		}
+		if (bgfx::isValid(m_hizProgram))
+		{
+			bgfx::destroy(m_hizProgram);
+		}
+		if (m_cullingSupported)
+		{
+			bgfx::destroy(m_cullModelsProgram);
+			bgfx::destroy(m_cullDrawsProgram);
+		}
+		if (bgfx::isValid(m_drawInfo) )
+		{
+			bgfx::destroy(m_culledInstances);
+			bgfx::destroy(m_meshCounts);
+			bgfx::destroy(m_drawInfo);
+			bgfx::destroy(m_indirect);
+		}
+		for (uint32_t mode = 0; mode < SHADOWS_VARIANT_MODES; ++mode)
+		{
+			for (uint32_t radius = 0; radius < SHADOWS_VARIANT_RADIUS; ++radius)
+			{
+				for (uint32_t steps = 0; steps < BX_COUNTOF(s_shadowStepBuckets); ++steps)
+				{
+					if (bgfx::isValid(m_shadowsVariants[mode][radius][steps]))
+					{
+						bgfx::destroy(m_shadowsVariants[mode][radius][steps]);
+					}
+					if (bgfx::isValid(m_shadowsComputeVariants[mode][radius][steps]))
+					{
+						bgfx::destroy(m_shadowsComputeVariants[mode][radius][steps]);
+					}
+				}
+			}
+		}
 
 		m_uniforms.destroy();
 
@@ -373,8 +1306,18 @@ public:
 		bgfx::destroy(s_normal);
 		bgfx::destroy(s_depth);
 		bgfx::destroy(s_shadows);
+		bgfx::destroy(s_depthLowRes);
+		bgfx::destroy(s_hiz);
+		bgfx::destroy(s_hizMax);
+		bgfx::destroy(s_shadowsHistory);
+		bgfx::destroy(s_depthHistory);
+		bgfx::destroy(s_blueNoise);
+		bgfx::destroy(s_clusters);
+		bgfx::destroy(s_clusterLights);
+		bgfx::destroy(s_clusterIndices);
 
 		destroyFramebuffers();
+		m_graph.shutdown();
 
 		cameraDestroy();
 
@@ -382,11 +1325,20 @@ public:
 
 		bgfx::shutdown();
 
+		// pending readback may write until shutdown
+		freeValidation();
+
 		return 0;
 	}
 
 	bool update() override
 	{
+		// only baking meshes, nothing to draw
+		if (m_bakeMeshes)
+		{
+			return false;
+		}
+
 		if (!entry::processEvents(m_width, m_height, m_debug, m_reset, &m_mouseState))
 		{
 			// skip processing when minimized, otherwise crashing
@@ -404,8 +1356,68 @@ public:
 			const float deltaTime = float(frameTime / freq);
 			const bgfx::Caps* caps = bgfx::getCaps();
 
-			if (m_size[0] != (int32_t)m_width
-			||  m_size[1] != (int32_t)m_height
+			if (0 == m_firstFrameTime)
+			{
+				m_firstFrameTime = now;
+				DBG("First frame after %.1f ms", double(m_firstFrameTime - m_initTime) * 1000.0 / freq);
+			}
+			if (m_numLoaded < m_loader.getNumJobs() )
+			{
+				updateLoading();
+			}
+
+			// Per view timings are only collected by profiler
+			bgfx::setDebug(m_debug | ( (m_compareShaders || m_benchmark || m_showProfiler || m_useDynamicResolution) ? BGFX_DEBUG_PROFILER : 0) );
+			if (m_showProfiler)
+			{
+				updateProfiler();
+			}
+			if (UINT32_MAX != m_readbackFrame
+			&&  m_readbackFrame <= m_currFrame)
+			{
+				runValidation();
+			}
+			if (UINT32_MAX != m_overdrawFrame
+			&&  m_overdrawFrame <= m_currFrame)
+			{
+				updateOverdraw();
+			}
+			if (0 <= m_scalingStep)
+			{
+				updateScaling();
+			}
+			m_uniformSubmits = m_uniforms.m_submitCount;
+			m_uniformBytes = m_uniforms.m_submitBytes;
+			m_uniforms.m_submitCount = 0;
+			m_uniforms.m_submitBytes = 0;
+
+			// measure complete scene only
+			if (m_benchmark && m_assetsLoaded)
+			{
+				if (!updateBenchmark() )
+				{
+					return false;
+				}
+				applyBenchmarkConfig();
+			}
+			if (m_compareShaders)
+			{
+				updateComparison();
+			}
+
+			// While window is being resized, keep rendering at previous size and
+			// stretch to backbuffer instead of recreating targets every frame
+			if (m_pendingSize[0] != (int32_t)m_width
+			||  m_pendingSize[1] != (int32_t)m_height)
+			{
+				m_pendingSize[0] = m_width;
+				m_pendingSize[1] = m_height;
+				m_pendingSizeFrames = 0;
+			}
+			++m_pendingSizeFrames;
+			const bool sizeSettled = m_benchmark || RESIZE_SETTLE_FRAMES <= m_pendingSizeFrames;
+
+			if ( (sizeSettled && (m_size[0] != (int32_t)m_width || m_size[1] != (int32_t)m_height) )
 			||  m_recreateFrameBuffers)
 			{
 				destroyFramebuffers();
@@ -413,75 +1425,196 @@ public:
 				m_recreateFrameBuffers = false;
 			}
 
-			// rotate light
+			// full, half, or quarter resolution
+			m_traceDownscale = 1 << m_traceResolution;
+			m_traceSize[0] = bx::max(m_size[0] / m_traceDownscale, 1);
+			m_traceSize[1] = bx::max(m_size[1] / m_traceDownscale, 1);
+
+			// rotate light, benchmark follows same path for every configuration
 			const float rotationSpeed = m_moveLight ? 0.75f : 0.0f;
 			m_lightRotation += deltaTime * rotationSpeed;
+			if (m_benchmark)
+			{
+				m_lightRotation = bx::kPi2 * benchmarkProgress();
+			}
 			if (bx::kPi2 < m_lightRotation)
 			{
 				m_lightRotation -= bx::kPi2;
 			}
-			m_lightModel.position[0] = bx::cos(m_lightRotation) * 3.0f;
-			m_lightModel.position[1] = 1.5f;
-			m_lightModel.position[2] = bx::sin(m_lightRotation) * 3.0f;
+			// spread lights evenly around the circle
+			for (int32_t ii = 0; ii < m_lightCount; ++ii)
+			{
+				const float angle = m_lightRotation + bx::kPi2 * float(ii) / float(m_lightCount);
+				m_lightModels[ii].position[0] = bx::cos(angle) * 3.0f;
+				m_lightModels[ii].position[1] = 1.5f;
+				m_lightModels[ii].position[2] = bx::sin(angle) * 3.0f;
+			}
 
 			// Update camera
 			cameraUpdate(deltaTime*0.15f, m_mouseState);
 
 			// Set up matrices for gbuffer
 			cameraGetViewMtx(m_view);
+			if (m_benchmark)
+			{
+				// sway around default camera position, looking at scene center
+				const float angle = bx::kPi * 0.25f * bx::sin(bx::kPi2 * benchmarkProgress() );
+				const bx::Vec3 eye = { 4.0f * bx::sin(angle), 1.5f, -4.0f * bx::cos(angle) };
+				const bx::Vec3 at = { 0.0f, 0.5f, 0.0f };
+				bx::mtxLookAt(m_view, eye, at);
+			}
 
+			updateDynamicResolution();
 			updateUniforms();
+			if (useClusteredLighting() )
+			{
+				updateClusters();
+			}
 
-			bx::mtxProj(m_proj, m_fovY, float(m_size[0]) / float(m_size[1]), 0.01f, 100.0f, caps->homogeneousDepth);
-			bx::mtxProj(m_proj2, m_fovY, float(m_size[0]) / float(m_size[1]), 0.01f, 100.0f, false);
+			// reversed z swaps near and far, depth is 1 at near plane and float
+			// precision is spent where perspective divide compresses depth
+			const float projNear = m_activeReversedZ ? CAMERA_FAR  : CAMERA_NEAR;
+			const float projFar  = m_activeReversedZ ? CAMERA_NEAR : CAMERA_FAR;
+			bx::mtxProj(m_proj, m_fovY, float(m_size[0]) / float(m_size[1]), projNear, projFar, caps->homogeneousDepth);
+			bx::mtxProj(m_proj2, m_fovY, float(m_size[0]) / float(m_size[1]), projNear, projFar, false);
+
+			// Views and transient targets of enabled passes
+			buildGraph();
+			const GraphPasses& passes = m_graphPasses;
+			const GraphTargets& targets = m_graphTargets;
+			if (DepthSource::LinearPass == m_activeDepthSource)
+			{
+				m_depthTexture = m_graph.getTexture(targets.m_depth);
+			}
 
-			bgfx::ViewId view = 0;
+			// Cull models on gpu and write indirect draws for gbuffer
+			if (m_graph.isActive(passes.m_cull) )
+			{
+				const bgfx::ViewId view = m_graph.getView(passes.m_cull);
+				updateCullUniforms();
 
-			// Draw everything into gbuffer
+				bgfx::setBuffer(0, m_instanceBuffer, bgfx::Access::Read);
+				bgfx::setBuffer(1, m_culledInstances, bgfx::Access::Write);
+				bgfx::setBuffer(2, m_meshCounts, bgfx::Access::ReadWrite);
+				bgfx::setTexture(3, s_hizMax, m_hizMax);
+				m_uniforms.submit();
+				bgfx::dispatch(view
+					, m_cullModelsProgram
+					, (uint32_t(m_modelCount) + CULL_GROUP_SIZE - 1) / CULL_GROUP_SIZE
+					);
+
+				bgfx::setBuffer(0, m_drawInfo, bgfx::Access::Read);
+				bgfx::setBuffer(1, m_meshCounts, bgfx::Access::ReadWrite);
+				bgfx::setBuffer(2, m_indirect, bgfx::Access::Write);
+				m_uniforms.submit();
+				bgfx::dispatch(view, m_cullDrawsProgram);
+			}
+
+			// Models submitted one by one go front to back, so nearer models
+			// hide farther ones before they are shaded
+			m_modelsSorted = m_sortModels && !m_useInstancing;
+			if (m_modelsSorted)
 			{
-				bgfx::setViewName(view, "gbuffer");
+				sortModels();
+			}
+
+			// Depth only, so gbuffer shades each pixel once
+			const bool depthPrepass = m_graph.isActive(passes.m_depthPrepass);
+			if (depthPrepass)
+			{
+				const bgfx::ViewId view = m_graph.getView(passes.m_depthPrepass);
 				bgfx::setViewClear(view
 					, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH
+					, m_activeReversedZ ? 0.0f : 1.0f
+					, 0
 					, 0
-					, 1.0f
 					, 0
+					, 1
 				);
 
 				bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
 				bgfx::setViewTransform(view, m_view, m_proj);
-				// Make sure when we draw it goes into gbuffer and not backbuffer
+				bgfx::setViewMode(view, bgfx::ViewMode::Sequential);
 				bgfx::setViewFrameBuffer(view, m_gbuffer);
 
-				bgfx::setState(0
-					| BGFX_STATE_WRITE_RGB
-					| BGFX_STATE_WRITE_A
-					| BGFX_STATE_WRITE_Z
-					| BGFX_STATE_DEPTH_TEST_LESS
+				drawAllModels(view
+					, m_depthPrepassProgram
+					, m_depthPrepassInstancedProgram
+					, m_gbufferState & ~(BGFX_STATE_WRITE_RGB | BGFX_STATE_WRITE_A)
+					, m_uniforms
 					);
+			}
+
+			// Draw everything into gbuffer
+			{
+				const bgfx::ViewId view = m_graph.getView(passes.m_gbuffer);
+				if (!depthPrepass)
+				{
+					bgfx::setViewClear(view
+						, BGFX_CLEAR_COLOR | BGFX_CLEAR_DEPTH
+						, m_activeReversedZ ? 0.0f : 1.0f
+						, 0
+						, 0
+						, 0
+						, 1
+					);
+				}
+
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
+				bgfx::setViewTransform(view, m_view, m_proj);
+				// Uniforms are only uploaded with first draw that sees them change
+				bgfx::setViewMode(view, bgfx::ViewMode::Sequential);
+				// Make sure when we draw it goes into gbuffer and not backbuffer
+				bgfx::setViewFrameBuffer(view, m_gbuffer);
 
-				drawAllModels(view, m_gbufferProgram, m_uniforms);
+				const bool writeLinearDepth = DepthSource::GbufferTarget == m_activeDepthSource;
+				const int32_t layout = m_activeGbufferLayout;
+				bgfx::ProgramHandle program = writeLinearDepth ? m_gbufferLinearDepthProgram[layout] : m_gbufferProgram[layout];
+				bgfx::ProgramHandle instancedProgram = writeLinearDepth ? m_gbufferInstancedLinearDepthProgram[layout] : m_gbufferInstancedProgram[layout];
+				bgfx::ProgramHandle sphereProgram = writeLinearDepth ? m_sphereLinearDepthProgram[layout] : m_sphereProgram[layout];
+
+				// Models after prepass only pass where their depth is equal.
+				// Overdraw display counts fragments by blending into color
+				uint64_t modelState = depthPrepass
+					? (m_gbufferState & ~(BGFX_STATE_WRITE_Z | BGFX_STATE_DEPTH_TEST_MASK) ) | BGFX_STATE_DEPTH_TEST_EQUAL
+					: m_gbufferState
+					;
+				uint64_t sphereState = m_gbufferState;
+				if (m_displayOverdraw)
+				{
+					const uint64_t overdrawState = BGFX_STATE_BLEND_ADD | (writeLinearDepth ? BGFX_STATE_BLEND_INDEPENDENT : 0);
+					modelState |= overdrawState;
+					sphereState |= overdrawState;
+					program = writeLinearDepth ? m_overdrawLinearDepthProgram : m_overdrawProgram;
+					instancedProgram = writeLinearDepth ? m_overdrawInstancedLinearDepthProgram : m_overdrawInstancedProgram;
+					sphereProgram = program;
+				}
+
+				const int64_t submitStart = bx::getHPCounter();
+				drawAllModels(view
+					, program
+					, instancedProgram
+					, modelState
+					, m_uniforms
+					);
+				m_modelSubmitTime = bx::getHPCounter() - submitStart;
 
-				// draw sphere to visualize light
+				// draw spheres to visualize lights
+				for (int32_t ii = 0; ii < m_lightCount && NULL != m_meshes[0]; ++ii)
 				{
-					const float scale = s_meshScale[m_lightModel.mesh];
+					const Model& lightModel = m_lightModels[ii];
 					float mtx[16];
-					bx::mtxSRT(mtx
-						, scale
-						, scale
-						, scale
-						, 0.0f
-						, 0.0f
-						, 0.0f
-						, m_lightModel.position[0]
-						, m_lightModel.position[1]
-						, m_lightModel.position[2]
-						);
+					modelMtx(mtx, lightModel.mesh, lightModel.position);
 
 					m_uniforms.submit();
-					meshSubmit(m_meshes[m_lightModel.mesh], view, m_sphereProgram, mtx);
+					meshSubmit(m_meshes[lightModel.mesh], view, sphereProgram, mtx, sphereState);
 				}
+			}
 
-				++view;
+			// Copy overdraw counts back to cpu
+			if (m_graph.isActive(passes.m_overdrawReadback) )
+			{
+				requestOverdraw(m_graph.getView(passes.m_overdrawReadback) );
 			}
 
 			float orthoProj[16];
@@ -494,12 +1627,13 @@ public:
 			}
 
 			// Convert depth to linear depth for shadow depth compare
+			if (m_graph.isActive(passes.m_linearDepth) )
 			{
-				bgfx::setViewName(view, "linear depth");
+				const bgfx::ViewId view = m_graph.getView(passes.m_linearDepth);
 
-				bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
 				bgfx::setViewTransform(view, NULL, orthoProj);
-				bgfx::setViewFrameBuffer(view, m_linearDepth.m_buffer);
+				bgfx::setViewFrameBuffer(view, m_graph.getBuffer(targets.m_depth) );
 				bgfx::setState(0
 					| BGFX_STATE_WRITE_RGB
 					| BGFX_STATE_WRITE_A
@@ -507,33 +1641,225 @@ public:
 					);
 				bgfx::setTexture(0, s_depth, m_gbufferTex[GBUFFER_RT_DEPTH]);
 				m_uniforms.submit();
-				screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, caps->originBottomLeft);
+				screenSpaceQuad(float(m_size[0]), float(m_size[1]), m_texelHalf, caps->originBottomLeft);
 				bgfx::submit(view, m_linearDepthProgram);
-				++view;
 			}
 
-			// Do screen space shadows
+			// Build min and max depth pyramid, one level per dispatch. Occlusion
+			// culling tests against it next frame
+			if (m_graph.isActive(passes.m_hiz) )
 			{
-				bgfx::setViewName(view, "screen space shadows");
+				const bgfx::ViewId view = m_graph.getView(passes.m_hiz);
 
-				bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
+				for (uint8_t mip = 0; mip < m_hizLevels; ++mip)
+				{
+					const int32_t sourceWidth  = (0 == mip) ? m_size[0] : bx::max(m_hizSize[0] >> (mip-1), 1);
+					const int32_t sourceHeight = (0 == mip) ? m_size[1] : bx::max(m_hizSize[1] >> (mip-1), 1);
+					const int32_t targetWidth  = bx::max(m_hizSize[0] >> mip, 1);
+					const int32_t targetHeight = bx::max(m_hizSize[1] >> mip, 1);
+
+					if (0 == mip)
+					{
+						bgfx::setImage(0, m_depthTexture, 0, bgfx::Access::Read, bgfx::TextureFormat::R16F);
+						bgfx::setImage(2, m_depthTexture, 0, bgfx::Access::Read, bgfx::TextureFormat::R16F);
+					}
+					else
+					{
+						bgfx::setImage(0, m_hiz, mip-1, bgfx::Access::Read, bgfx::TextureFormat::R16F);
+						bgfx::setImage(2, m_hizMax, mip-1, bgfx::Access::Read, bgfx::TextureFormat::R16F);
+					}
+					bgfx::setImage(1, m_hiz, mip, bgfx::Access::Write, bgfx::TextureFormat::R16F);
+					bgfx::setImage(3, m_hizMax, mip, bgfx::Access::Write, bgfx::TextureFormat::R16F);
+
+					vec2Set(m_uniforms.m_hizSourceSize, float(sourceWidth), float(sourceHeight));
+					vec2Set(m_uniforms.m_hizTargetSize, float(targetWidth), float(targetHeight));
+					m_uniforms.submit();
+					bgfx::dispatch(view
+						, m_hizProgram
+						, (targetWidth  + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE
+						, (targetHeight + HIZ_GROUP_SIZE - 1) / HIZ_GROUP_SIZE
+						);
+				}
+			}
+
+			// Trace at reduced resolution against downsampled depth, then
+			// upsample result to full resolution before combine
+			const bool reducedResolution = useUpsample();
+			const bgfx::TextureHandle traceDepth = reducedResolution ? m_graph.getTexture(targets.m_linearDepthLowRes) : m_depthTexture;
+			const uint16_t traceShadows = reducedResolution ? targets.m_shadowsLowRes : targets.m_shadows;
+
+			if (m_graph.isActive(passes.m_downsampleDepth) )
+			{
+				const bgfx::ViewId view = m_graph.getView(passes.m_downsampleDepth);
+
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_traceSize[0]), uint16_t(m_traceSize[1]));
 				bgfx::setViewTransform(view, NULL, orthoProj);
-				bgfx::setViewFrameBuffer(view, m_shadows.m_buffer);
+				bgfx::setViewFrameBuffer(view, m_graph.getBuffer(targets.m_linearDepthLowRes) );
 				bgfx::setState(0
 					| BGFX_STATE_WRITE_RGB
 					| BGFX_STATE_WRITE_A
 					| BGFX_STATE_DEPTH_TEST_ALWAYS
 					);
-				bgfx::setTexture(0, s_depth, m_linearDepth.m_texture);
+				bgfx::setTexture(0, s_depth, m_depthTexture);
 				m_uniforms.submit();
-				screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, caps->originBottomLeft);
-				bgfx::submit(view, m_shadowsProgram);
-				++view;
+				screenSpaceQuad(float(m_traceSize[0]), float(m_traceSize[1]), m_texelHalf, caps->originBottomLeft);
+				bgfx::submit(view, m_downsampleDepthProgram);
+			}
+
+			// Do screen space shadows, downsampled depth is always linear.
+			// Compute and fragment path share a view name, so stats line up
+			const bgfx::ViewId shadowsView = m_graph.getView(passes.m_shadows);
+			m_shadowsView = shadowsView;
+			m_uniforms.m_depthIsHardware = (m_depthIsHardware && !reducedResolution) ? 1.0f : 0.0f;
+			if (m_useComputeShadows)
+			{
+				const bgfx::ViewId view = shadowsView;
+
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_scaledTraceSize[0]), uint16_t(m_scaledTraceSize[1]));
+				bgfx::setTexture(0, s_depth, traceDepth);
+				bgfx::setImage(1, m_graph.getTexture(traceShadows), 0, bgfx::Access::Write, bgfx::TextureFormat::RGBA8);
+				if (m_computeSupported)
+				{
+					bgfx::setTexture(2, s_hiz, m_hiz);
+				}
+				bgfx::setTexture(3, s_blueNoise, m_blueNoiseTexture);
+				m_uniforms.submit();
+				bgfx::dispatch(view
+					, getShadowsProgram(true)
+					, (m_scaledTraceSize[0] + SHADOWS_TILE_SIZE - 1) / SHADOWS_TILE_SIZE
+					, (m_scaledTraceSize[1] + SHADOWS_TILE_SIZE - 1) / SHADOWS_TILE_SIZE
+					);
+			}
+			else
+			{
+				const bgfx::ViewId view = shadowsView;
+
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_scaledTraceSize[0]), uint16_t(m_scaledTraceSize[1]));
+				bgfx::setViewTransform(view, NULL, orthoProj);
+				bgfx::setViewFrameBuffer(view, m_graph.getBuffer(traceShadows) );
+				bgfx::setState(0
+					| BGFX_STATE_WRITE_RGB
+					| BGFX_STATE_WRITE_A
+					| BGFX_STATE_DEPTH_TEST_ALWAYS
+					);
+				bgfx::setTexture(0, s_depth, traceDepth);
+				if (m_computeSupported)
+				{
+					bgfx::setTexture(2, s_hiz, m_hiz);
+				}
+				bgfx::setTexture(3, s_blueNoise, m_blueNoiseTexture);
+				m_uniforms.submit();
+				screenSpaceQuad(float(m_scaledTraceSize[0]), float(m_scaledTraceSize[1]), m_texelHalf, caps->originBottomLeft);
+				bgfx::submit(view, getShadowsProgram(false) );
+			}
+			m_uniforms.m_depthIsHardware = m_depthIsHardware ? 1.0f : 0.0f;
+
+			if (m_graph.isActive(passes.m_upsampleShadows) )
+			{
+				const bgfx::ViewId view = m_graph.getView(passes.m_upsampleShadows);
+
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
+				bgfx::setViewTransform(view, NULL, orthoProj);
+				bgfx::setViewFrameBuffer(view, m_graph.getBuffer(targets.m_shadows) );
+				bgfx::setState(0
+					| BGFX_STATE_WRITE_RGB
+					| BGFX_STATE_WRITE_A
+					| BGFX_STATE_DEPTH_TEST_ALWAYS
+					);
+				bgfx::setTexture(0, s_shadows, m_graph.getTexture(targets.m_shadowsLowRes) );
+				bgfx::setTexture(1, s_depth, m_depthTexture);
+				bgfx::setTexture(2, s_depthLowRes, m_graph.getTexture(targets.m_linearDepthLowRes) );
+				bgfx::setTexture(3, s_normal, m_gbufferTex[GBUFFER_RT_NORMAL]);
+				vec2Set(m_uniforms.m_shadowsUvScale, m_shadowsUvScale[0], m_shadowsUvScale[1]);
+				m_uniforms.submit();
+				screenSpaceQuad(float(m_size[0]), float(m_size[1]), m_texelHalf, caps->originBottomLeft);
+				bgfx::submit(view, m_upsampleShadowsProgram[m_activeGbufferLayout]);
+			}
+
+			// Copy depth as is into a float target that can be blit, hardware
+			// depth formats can't
+			if (m_graph.isActive(passes.m_copyDepth) )
+			{
+				const bgfx::ViewId view = m_graph.getView(passes.m_copyDepth);
+
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
+				bgfx::setViewTransform(view, NULL, orthoProj);
+				bgfx::setViewFrameBuffer(view, m_graph.getBuffer(targets.m_readbackDepth) );
+				bgfx::setState(0
+					| BGFX_STATE_WRITE_RGB
+					| BGFX_STATE_WRITE_A
+					| BGFX_STATE_DEPTH_TEST_ALWAYS
+					);
+				bgfx::setTexture(0, s_depth, m_depthTexture);
+				screenSpaceQuad(float(m_size[0]), float(m_size[1]), m_texelHalf, caps->originBottomLeft);
+				bgfx::submit(view, m_copyDepthProgram);
+			}
+
+			// Copy depth and shadows before temporal for cpu reference
+			if (m_graph.isActive(passes.m_readback) )
+			{
+				requestValidation(
+					  m_graph.getView(passes.m_readback)
+					, m_graph.getTexture(targets.m_readbackDepth)
+					, m_graph.getTexture(targets.m_shadows)
+					);
+			}
+
+			// Separable depth aware blur, denoised shadows may share a target
+			// with raw shadows since nothing reads those after first blur
+			if (m_graph.isActive(passes.m_blurX) )
+			{
+				for (uint32_t pass = 0; pass < 2; ++pass)
+				{
+					const uint16_t source = (0 == pass) ? targets.m_shadows : targets.m_shadowsBlur;
+					const uint16_t target = (0 == pass) ? targets.m_shadowsBlur : targets.m_shadowsDenoised;
+					const bgfx::ViewId view = m_graph.getView((0 == pass) ? passes.m_blurX : passes.m_blurY);
+
+					bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
+					bgfx::setViewTransform(view, NULL, orthoProj);
+					bgfx::setViewFrameBuffer(view, m_graph.getBuffer(target) );
+					bgfx::setState(0
+						| BGFX_STATE_WRITE_RGB
+						| BGFX_STATE_WRITE_A
+						| BGFX_STATE_DEPTH_TEST_ALWAYS
+						);
+					bgfx::setTexture(0, s_shadows, m_graph.getTexture(source) );
+					bgfx::setTexture(1, s_depth, m_depthTexture);
+					m_uniforms.m_blurVertical = float(pass);
+					m_uniforms.submit();
+					screenSpaceQuad(float(m_size[0]), float(m_size[1]), m_texelHalf, caps->originBottomLeft);
+					bgfx::submit(view, m_blurShadowsProgram);
+				}
+			}
+
+			// Blend with reprojected history, write this frame's history
+			const HistoryTarget& history = m_history[m_historyIdx];
+			const HistoryTarget& prevHistory = m_history[1 - m_historyIdx];
+			if (m_graph.isActive(passes.m_temporal) )
+			{
+				const bgfx::ViewId view = m_graph.getView(passes.m_temporal);
+
+				bgfx::setViewRect(view, 0, 0, uint16_t(m_size[0]), uint16_t(m_size[1]));
+				bgfx::setViewTransform(view, NULL, orthoProj);
+				bgfx::setViewFrameBuffer(view, history.m_buffer);
+				bgfx::setState(0
+					| BGFX_STATE_WRITE_RGB
+					| BGFX_STATE_WRITE_A
+					| BGFX_STATE_DEPTH_TEST_ALWAYS
+					);
+				bgfx::setTexture(0, s_shadows, m_graph.getTexture(targets.m_resolvedShadows) );
+				bgfx::setTexture(1, s_depth, m_depthTexture);
+				// bilinear history, point sampled depth for disocclusion test
+				bgfx::setTexture(2, s_shadowsHistory, prevHistory.m_shadows, BGFX_SAMPLER_U_CLAMP | BGFX_SAMPLER_V_CLAMP);
+				bgfx::setTexture(3, s_depthHistory, prevHistory.m_depth);
+				m_uniforms.submit();
+				screenSpaceQuad(float(m_size[0]), float(m_size[1]), m_texelHalf, caps->originBottomLeft);
+				bgfx::submit(view, m_temporalProgram);
 			}
 
-			// Shade gbuffer
+			// Shade gbuffer, stretched to backbuffer while a resize settles
 			{
-				bgfx::setViewName(view, "combine");
+				const bgfx::ViewId view = m_graph.getView(passes.m_combine);
 
 				bgfx::setViewRect(view, 0, 0, uint16_t(m_width), uint16_t(m_height));
 				bgfx::setViewTransform(view, NULL, orthoProj);
@@ -545,12 +1871,17 @@ public:
 					);
 				bgfx::setTexture(0, s_color, m_gbufferTex[GBUFFER_RT_COLOR]);
 				bgfx::setTexture(1, s_normal, m_gbufferTex[GBUFFER_RT_NORMAL]);
-				bgfx::setTexture(2, s_depth, m_linearDepth.m_texture);
-				bgfx::setTexture(3, s_shadows, m_shadows.m_texture);
+				bgfx::setTexture(2, s_depth, m_depthTexture);
+				bgfx::setTexture(3, s_shadows, m_useTemporal ? history.m_shadows : m_graph.getTexture(targets.m_resolvedShadows) );
+				if (useClusteredLighting() )
+				{
+					bgfx::setTexture(4, s_clusters, m_clusterTexture);
+					bgfx::setTexture(5, s_clusterLights, m_clusterLightTexture);
+					bgfx::setTexture(6, s_clusterIndices, m_clusterIndexTexture);
+				}
 				m_uniforms.submit();
 				screenSpaceQuad(float(m_width), float(m_height), m_texelHalf, caps->originBottomLeft);
-				bgfx::submit(view, m_combineProgram);
-				++view;
+				bgfx::submit(view, m_combineProgram[m_activeGbufferLayout]);
 			}
 
 			// Draw UI
@@ -581,6 +1912,11 @@ public:
 
 			ImGui::PushItemWidth(ImGui::GetWindowWidth() * 0.5f);
 
+			if (!m_assetsLoaded)
+			{
+				ImGui::Text("loading assets %d/%d", m_numLoaded, m_loader.getNumJobs() );
+			}
+
 			{
 				ImGui::Text("shadow controls:");
 				ImGui::Checkbox("screen space radius", &m_useScreenSpaceRadius);
@@ -596,10 +1932,29 @@ public:
 					ImGui::SliderFloat("radius in world units", &m_shadowRadius, 1e-3f, 1.0f);
 				}
 
-				ImGui::SliderInt("shadow steps", &m_shadowSteps, 1, 64);
+				if (m_useSpecialisedShadows)
+				{
+					int32_t bucket = shadowStepsBucket(m_shadowSteps);
+					if (ImGui::Combo("shadow steps", &bucket, "4\08\016\032\0\0") )
+					{
+						m_shadowSteps = s_shadowStepBuckets[bucket];
+					}
+				}
+				else
+				{
+					ImGui::SliderInt("shadow steps", &m_shadowSteps, 1, 64);
+				}
 				if (ImGui::IsItemHovered())
 					ImGui::SetTooltip("number of steps/samples to take between shaded pixel and radius");
 
+				ImGui::Checkbox("adaptive steps", &m_useAdaptiveSteps);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("take at most one step per depth texel the ray crosses, skipping shaded pixel's own texel");
+
+				ImGui::Checkbox("screen space march", &m_useScreenSpaceMarch);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("project ray once and step evenly in screen space, interpolating 1/z for depth. hi-z traversal takes precedence");
+
 				ImGui::Combo("contact shadows mode", &m_contactShadowsMode, "hard\0soft\0very soft\0pcsssss\0\0");
 				if (ImGui::IsItemHovered())
 				{
@@ -615,22 +1970,294 @@ public:
 					ImGui::EndTooltip();
 				}
 
+				if (ImGui::Checkbox("specialised shaders", &m_useSpecialisedShadows) )
+				{
+					// Step count must be one of compiled buckets
+					m_shadowSteps = s_shadowStepBuckets[shadowStepsBucket(m_shadowSteps)];
+					m_compareShaders = m_compareShaders && m_useSpecialisedShadows;
+					resetComparison();
+				}
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("use shader compiled for current mode, radius and step count instead of branching on uniforms");
+
+				if (m_useSpecialisedShadows)
+				{
+					if (ImGui::Checkbox("compare against uber-shader", &m_compareShaders) )
+					{
+						resetComparison();
+					}
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("alternate programs every few frames and average gpu time of shadow pass");
+
+					if (m_compareShaders)
+					{
+						const double uberMs = 0 < m_compareSamples[0] ? m_compareTime[0] / m_compareSamples[0] : 0.0;
+						const double specialisedMs = 0 < m_compareSamples[1] ? m_compareTime[1] / m_compareSamples[1] : 0.0;
+						ImGui::Text("uber: %.3f ms", uberMs);
+						ImGui::Text("specialised: %.3f ms", specialisedMs);
+						if (0.0 < specialisedMs)
+						{
+							ImGui::Text("speedup: %.2fx", uberMs / specialisedMs);
+						}
+					}
+				}
+
 				ImGui::Checkbox("add random offset to initial position", &m_useNoiseOffset);
 				if (ImGui::IsItemHovered())
 					ImGui::SetTooltip("hide banding with noise");
 
 				ImGui::Checkbox("use different offset each frame", &m_dynamicNoise);
+				ImGui::Checkbox("blue noise offset", &m_useBlueNoise);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("offsets from tiled blue noise, shifted by golden ratio each frame, instead of white noise");
+
+				ImGui::Checkbox("denoise", &m_useDenoise);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("separable depth aware blur of full resolution shadows, before temporal");
+
+				ImGui::Checkbox("temporal accumulation", &m_useTemporal);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("blend with reprojected previous frames, works best with different offset each frame");
+
+				if (m_useTemporal)
+				{
+					ImGui::SliderFloat("temporal blend", &m_temporalBlend, 0.02f, 1.0f);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("weight of current frame, lower is smoother but slower to react");
+				}
+
+				ImGui::Combo("trace resolution", &m_traceResolution, "full\0half\0quarter\0\0");
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("march fewer rays and upsample with depth and normal aware filter");
+
+				if (ImGui::Checkbox("dynamic resolution", &m_useDynamicResolution) )
+				{
+					m_dynamicScale = 1.0f;
+					m_dynamicStepScale = 1.0f;
+				}
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("shrink trace viewport until shadows gpu time fits budget");
+				if (m_useDynamicResolution)
+				{
+					ImGui::SliderFloat("shadows budget ms", &m_shadowsBudgetMs, 0.1f, 8.0f);
+					if (ImGui::Checkbox("dynamic steps", &m_useDynamicSteps) )
+					{
+						m_dynamicStepScale = 1.0f;
+					}
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("also reduce steps once viewport reaches min scale");
+					ImGui::Text("trace %dx%d, steps %d", m_scaledTraceSize[0], m_scaledTraceSize[1], dynamicShadowSteps() );
+				}
+
+				if (ImGui::Combo("linear depth source", &m_depthSource, "linear depth pass\0gbuffer target\0inline from depth buffer\0\0") )
+				{
+					m_recreateFrameBuffers = true;
+				}
+				if (ImGui::IsItemHovered())
+				{
+					ImGui::BeginTooltip();
+					ImGui::Text("linear depth pass");
+					ImGui::BulletText("full screen pass converts depth buffer after gbuffer");
+					ImGui::Text("gbuffer target");
+					ImGui::BulletText("gbuffer writes view space depth to an extra render target");
+					ImGui::Text("inline from depth buffer");
+					ImGui::BulletText("each pass converts depth buffer as it reads, no hi-z");
+					ImGui::EndTooltip();
+				}
+
+				if (m_reversedZSupported)
+				{
+					if (ImGui::Checkbox("reversed z", &m_useReversedZ) )
+					{
+						m_recreateFrameBuffers = true;
+					}
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("render to D32F with near and far swapped, precise enough to linearize inline");
+				}
+
+				if (m_compactGbufferSupported)
+				{
+					if (ImGui::Combo("gbuffer layout", &m_gbufferLayout, "default\0compact\0\0") )
+					{
+						m_recreateFrameBuffers = true;
+					}
+					if (ImGui::IsItemHovered())
+					{
+						ImGui::BeginTooltip();
+						ImGui::Text("default");
+						ImGui::BulletText("rgba8 albedo and material id, rgba8 oct24 normal and roughness");
+						ImGui::Text("compact");
+						ImGui::BulletText("rgba8 albedo, 6 bit roughness and material id, rg8 oct16 normal");
+						ImGui::BulletText("6 instead of 8 bytes per pixel written by gbuffer");
+						ImGui::EndTooltip();
+					}
+				}
+
+				if (m_computeSupported)
+				{
+					ImGui::Checkbox("use compute shader", &m_useComputeShadows);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("march rays against depth cached in groupshared memory");
+
+					ImGui::Checkbox("hi-z traversal", &m_useHiZ);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("skip ray segments in front of all geometry using a min depth pyramid");
+
+					if (m_useHiZ)
+					{
+						ImGui::SliderInt("hi-z step scale", &m_hizStepScale, 1, 8);
+						if (ImGui::IsItemHovered())
+							ImGui::SetTooltip("multiply steps, skipped spans make smaller steps affordable");
+					}
+				}
+				// reference traces every pixel with linear march, so compare
+				// full resolution shadows before upsample and temporal, and
+				// not hi-z traversal
+				if (m_readbackSupported && 0 == m_traceResolution && !m_useDynamicResolution && !m_useAdaptiveSteps && !m_useScreenSpaceMarch && !useHiZ() )
+				{
+					if (ImGui::Button("validate against cpu reference")
+					&&  UINT32_MAX == m_readbackFrame)
+					{
+						m_validationRequested = true;
+					}
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("read back depth and shadows, and compare with linear march on cpu. turn off random offset for exact match");
+
+					if (m_validationDone)
+					{
+						ImGui::Text("cpu reference: %.1f ms", m_validationTime);
+						for (uint32_t ii = 0; ii < m_validationParams.m_lightCount; ++ii)
+						{
+							ImGui::Text("light %d: mean %.4f, max %.3f, mismatch %.2f%%"
+								, ii
+								, m_validationMeanError[ii]
+								, m_validationMaxError[ii]
+								, m_validationMismatch[ii]
+								);
+						}
+					}
+				}
 				ImGui::Separator();
 
 				ImGui::Text("scene controls:");
 				ImGui::Checkbox("display shadows only", &m_displayShadows);
 				ImGui::Checkbox("move light", &m_moveLight);
+				ImGui::SliderInt("lights", &m_lightCount, 1, MAX_LIGHTS);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("all lights are traced in one pass, one per channel of shadows");
+				if (m_clusteredSupported)
+				{
+					ImGui::Checkbox("clustered lighting", &m_useClusteredLighting);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("combine shades only lights in each pixel's cluster of screen tile and depth slice. lights above cast shadows");
+				}
+				if (useClusteredLighting() )
+				{
+					ImGui::SliderInt("point lights", &m_pointLightCount, 0, MAX_POINT_LIGHTS);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("small lights without shadows, spread over models");
+					ImGui::Text("clusters: %u light indices, %.3f ms", m_clusterIndexCount, double(m_clusterTime) * 1000.0 / double(bx::getHPFrequency() ) );
+				}
+				if (ImGui::SliderInt("models", &m_modelCount, 1, MAX_MODEL_COUNT))
+				{
+					createModels();
+				}
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("models are spread over a larger area as count grows");
+				if (m_instancingSupported)
+				{
+					ImGui::Checkbox("instancing", &m_useInstancing);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("one draw per mesh with per instance position and scale, instead of one draw per model");
+				}
+				if (m_useInstancing && m_cullingSupported)
+				{
+					ImGui::Checkbox("gpu culling", &m_useCulling);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("compute pass tests models against frustum and writes indirect draws");
+					if (m_useCulling && DepthSource::HardwareInline != m_activeDepthSource)
+					{
+						ImGui::Checkbox("occlusion culling", &m_useOcclusionCulling);
+						if (ImGui::IsItemHovered())
+							ImGui::SetTooltip("also test against previous frame's max depth pyramid");
+					}
+				}
+				if (!m_useInstancing && 1 < m_maxSubmitThreads)
+				{
+					ImGui::SliderInt("submit threads", &m_submitThreads, 1, int32_t(m_maxSubmitThreads) );
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("models are split between threads, each submitting with its own encoder");
+
+					if (ImGui::Button("measure submit scaling")
+					&&  0 > m_scalingStep)
+					{
+						m_scalingStep = 0;
+						m_scalingFrame = 0;
+						m_scalingTime = 0;
+						m_scalingCount = 0;
+						m_scalingPrevThreads = m_submitThreads;
+						m_submitThreads = 1;
+					}
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("time model submission for powers of two threads up to max");
+
+					for (uint32_t ii = 0; ii < m_scalingCount; ++ii)
+					{
+						ImGui::Text("%2d threads: %.3f ms, %.2fx"
+							, m_scalingThreads[ii]
+							, m_scalingMs[ii]
+							, m_scalingMs[0] / bx::max(m_scalingMs[ii], 1e-6f)
+							);
+					}
+				}
+				if (!m_useInstancing)
+				{
+					ImGui::Checkbox("sort front to back", &m_sortModels);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("submit models nearest first, so depth test rejects hidden fragments before shading");
+					ImGui::Text("model sort: %.3f ms", double(m_modelSortTime) * 1000.0 / double(bx::getHPFrequency() ) );
+				}
+				ImGui::Checkbox("depth prepass", &m_useDepthPrepass);
+				if (ImGui::IsItemHovered())
+					ImGui::SetTooltip("draw depth only first, then gbuffer shades only fragments with equal depth");
+				if (DepthSource::GbufferTarget != m_activeDepthSource || m_blendIndependentSupported)
+				{
+					ImGui::Checkbox("display overdraw", &m_displayOverdraw);
+					if (ImGui::IsItemHovered())
+						ImGui::SetTooltip("color by gbuffer fragments shaded per pixel, blue to red up to 8");
+					if (m_displayOverdraw && m_readbackSupported)
+					{
+						ImGui::Text("overdraw: %.2f per pixel, %.2f covered", m_overdrawPerPixel, m_overdrawPerCovered);
+					}
+				}
+				else
+				{
+					// counting blends color, linear depth target can't be left out
+					m_displayOverdraw = false;
+				}
+				ImGui::Text("model submit: %.3f ms", double(m_modelSubmitTime) * 1000.0 / double(bx::getHPFrequency() ) );
+				ImGui::Separator();
+
+				ImGui::Checkbox("profiler", &m_showProfiler);
+				if (m_showProfiler)
+				{
+					showProfiler();
+				}
 			}
 
 			ImGui::End();
 
 			imguiEndFrame();
 
+			// This frame's history and matrices become previous for next frame
+			m_havePrevious = m_useTemporal;
+			m_havePreviousHiZ = m_graph.isActive(m_graphPasses.m_hiz);
+			m_historyIdx = 1 - m_historyIdx;
+			mat4Set(m_prevView, m_view);
+			mat4Set(m_prevProj, m_proj);
+
+			m_submitTime = bx::getHPCounter() - now;
+
 			// Advance to next frame. Rendering thread will be kicked to
 			// process submitted rendering primitives.
 			m_currFrame = bgfx::frame();
@@ -641,96 +2268,1677 @@ public:
 		return false;
 	}
 
-	void drawAllModels(bgfx::ViewId _pass, bgfx::ProgramHandle _program, const Uniforms & _uniforms)
+	// hi-z is built from linear depth, not available when it is never stored
+	bool useCulling() const
 	{
-		for (uint32_t ii = 0; ii < BX_COUNTOF(m_models); ++ii)
-		{
-			const Model& model = m_models[ii];
+		return m_useCulling
+			&& m_cullingSupported
+			&& m_useInstancing
+			&& bgfx::isValid(m_drawInfo)
+			;
+	}
 
-			// Set up transform matrix for each model
-			const float scale = s_meshScale[model.mesh];
-			float mtx[16];
-			bx::mtxSRT(mtx
-				, scale
-				, scale
-				, scale
-				, 0.0f
-				, 0.0f
-				, 0.0f
-				, model.position[0]
-				, model.position[1]
-				, model.position[2]
-				);
+	// Needs previous frame's depth pyramid, so not with inline depth
+	bool useOcclusionCulling() const
+	{
+		return m_useOcclusionCulling
+			&& useCulling()
+			&& DepthSource::HardwareInline != m_activeDepthSource
+			;
+	}
 
-			// Submit mesh to gbuffer
-			bgfx::setTexture(0, s_albedo, m_groundTexture);
-			bgfx::setTexture(1, s_normal, m_normalTexture);
-			_uniforms.submit();
+	bool useBlueNoise() const
+	{
+		return m_useBlueNoise
+			&& m_blueNoiseLoaded
+			;
+	}
 
-			meshSubmit(m_meshes[model.mesh], _pass, _program, mtx);
-		}
+	bool useHiZ() const
+	{
+		return m_useHiZ
+			&& m_computeSupported
+			&& DepthSource::HardwareInline != m_activeDepthSource
+			;
+	}
 
-		// Draw ground
-		float mtxScale[16];
-		const float scale = 10.0f;
-		bx::mtxScale(mtxScale, scale, scale, scale);
+	// Shadows traced into fewer pixels than the screen, by trace resolution or
+	// dynamic resolution, are brought back to full resolution by upsample
+	bool useUpsample() const
+	{
+		return 1 < m_traceDownscale
+			|| 1.0f > m_dynamicScale
+			;
+	}
 
-		float mtxTranslate[16];
-		bx::mtxTranslate(mtxTranslate
-			, 0.0f
-			, -10.0f
-			, 0.0f
-			);
+	int32_t shadowStepsBucket(int32_t _steps) const
+	{
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_shadowStepBuckets); ++ii)
+		{
+			if (_steps <= s_shadowStepBuckets[ii])
+			{
+				return int32_t(ii);
+			}
+		}
+		return int32_t(BX_COUNTOF(s_shadowStepBuckets) - 1);
+	}
 
-		float mtx[16];
-		bx::mtxMul(mtx, mtxScale, mtxTranslate);
-		bgfx::setTexture(0, s_albedo, m_groundTexture);
-		bgfx::setTexture(1, s_normal, m_normalTexture);
-		_uniforms.submit();
+	bool isUberShaderFrame() const
+	{
+		return m_compareShaders && 0 == (m_compareFrame / COMPARE_BLOCK_FRAMES) % 2;
+	}
 
-		meshSubmit(m_ground, _pass, _program, mtx);
+	// Shaders writing or reading gbuffer are built once per layout
+	bgfx::ProgramHandle loadGbufferProgram(const char* _vsName, const char* _fsName, int32_t _layout)
+	{
+		char name[64];
+		bx::snprintf(name, sizeof(name), "%s%s", _fsName, s_gbufferLayoutSuffix[_layout]);
+		return loadProgram(_vsName, name);
 	}
 
-	void createFramebuffers()
+	bgfx::ProgramHandle getShadowsProgram(bool _compute)
 	{
-		m_size[0] = m_width;
-		m_size[1] = m_height;
+		if (!m_useSpecialisedShadows || isUberShaderFrame() )
+		{
+			return _compute ? m_shadowsComputeProgram : m_shadowsProgram;
+		}
 
-		const uint64_t pointSampleFlags = 0
-			| BGFX_TEXTURE_RT
-			| BGFX_SAMPLER_U_CLAMP
-			| BGFX_SAMPLER_V_CLAMP
-			| BGFX_SAMPLER_MIN_POINT
-			| BGFX_SAMPLER_MAG_POINT
-			| BGFX_SAMPLER_MIP_POINT
+		const int32_t mode = m_contactShadowsMode;
+		const int32_t radius = m_useScreenSpaceRadius ? 1 : 0;
+		const int32_t steps = shadowStepsBucket(dynamicShadowSteps() );
+		bgfx::ProgramHandle& program = _compute
+			? m_shadowsComputeVariants[mode][radius][steps]
+			: m_shadowsVariants[mode][radius][steps]
 			;
 
-		m_gbufferTex[GBUFFER_RT_COLOR]    = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::BGRA8, pointSampleFlags);
-		m_gbufferTex[GBUFFER_RT_NORMAL]   = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::BGRA8, pointSampleFlags);
-		m_gbufferTex[GBUFFER_RT_DEPTH]    = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::D24, pointSampleFlags);
-		m_gbuffer = bgfx::createFrameBuffer(BX_COUNTOF(m_gbufferTex), m_gbufferTex, true);
+		if (!bgfx::isValid(program) )
+		{
+			char name[64];
+			bx::snprintf(name, sizeof(name), "%s_screen_space_shadows_m%d_r%d_s%d"
+				, _compute ? "cs" : "fs"
+				, mode
+				, radius
+				, s_shadowStepBuckets[steps]
+				);
+			program = _compute
+				? loadProgram(name, NULL)
+				: loadProgram("vs_sss_screenquad", name)
+				;
+		}
 
-		m_linearDepth.init(m_size[0], m_size[1], bgfx::TextureFormat::R16F, pointSampleFlags);
-		m_shadows.init(m_size[0], m_size[1], bgfx::TextureFormat::R16F, pointSampleFlags);
+		return program;
 	}
 
-	// all buffers set to destroy their textures
-	void destroyFramebuffers()
+	void resetComparison()
 	{
-		bgfx::destroy(m_gbuffer);
-
-		m_linearDepth.destroy();
-		m_shadows.destroy();
+		m_compareFrame = 0;
+		m_compareTime[0] = 0.0;
+		m_compareTime[1] = 0.0;
+		m_compareSamples[0] = 0;
+		m_compareSamples[1] = 0;
+	}
+
+	int32_t dynamicShadowSteps() const
+	{
+		return bx::max(int32_t(float(m_shadowSteps) * m_dynamicStepScale + 0.5f), 1);
+	}
+
+	// Move trace viewport scale, then steps, towards shadows budget. Cost is
+	// roughly pixels times steps, so scale follows square root of the ratio
+	void updateDynamicResolution()
+	{
+		if (m_useDynamicResolution)
+		{
+			float gpuMs = 0.0f;
+			const bgfx::Stats* stats = bgfx::getStats();
+			for (uint16_t ii = 0; ii < stats->numViews; ++ii)
+			{
+				const bgfx::ViewStats& viewStats = stats->viewStats[ii];
+				if (viewStats.view == m_shadowsView
+				&&  0 < stats->gpuTimerFreq)
+				{
+					gpuMs = float(double(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin) * 1000.0 / double(stats->gpuTimerFreq) );
+					break;
+				}
+			}
+
+			const float ratio = 0.0f < gpuMs ? m_shadowsBudgetMs / gpuMs : 1.0f;
+			if (ratio < 1.0f - DYNAMIC_DEADBAND)
+			{
+				if (DYNAMIC_SCALE_MIN < m_dynamicScale || !m_useDynamicSteps)
+				{
+					m_dynamicScale *= bx::lerp(1.0f, bx::sqrt(ratio), DYNAMIC_RATE);
+				}
+				else
+				{
+					m_dynamicStepScale *= bx::lerp(1.0f, ratio, DYNAMIC_RATE);
+				}
+			}
+			else if (1.0f + DYNAMIC_DEADBAND < ratio)
+			{
+				// give back steps before resolution
+				if (m_dynamicStepScale < 1.0f)
+				{
+					m_dynamicStepScale *= bx::lerp(1.0f, ratio, DYNAMIC_RATE);
+				}
+				else
+				{
+					m_dynamicScale *= bx::lerp(1.0f, bx::sqrt(ratio), DYNAMIC_RATE);
+				}
+			}
+			m_dynamicScale = bx::clamp(m_dynamicScale, DYNAMIC_SCALE_MIN, 1.0f);
+			m_dynamicStepScale = bx::clamp(m_dynamicStepScale, DYNAMIC_STEPS_MIN, 1.0f);
+		}
+		else
+		{
+			m_dynamicScale = 1.0f;
+			m_dynamicStepScale = 1.0f;
+		}
+
+		// trace into top left of targets, upsample scales its coordinates
+		for (uint32_t ii = 0; ii < 2; ++ii)
+		{
+			m_scaledTraceSize[ii] = bx::max(int32_t(float(m_traceSize[ii]) * m_dynamicScale), 1);
+			m_shadowsUvScale[ii] = float(m_scaledTraceSize[ii]) / float(m_traceSize[ii]);
+		}
+	}
+
+	void updateComparison()
+	{
+		// Stats describe last submitted frame, attribute them to program
+		// used then unless timer queries may still be from other program
+		if (0 < m_compareFrame)
+		{
+			const uint32_t lastFrame = m_compareFrame - 1;
+			if (COMPARE_SETTLE_FRAMES <= lastFrame % COMPARE_BLOCK_FRAMES)
+			{
+				const bgfx::Stats* stats = bgfx::getStats();
+				for (uint16_t ii = 0; ii < stats->numViews; ++ii)
+				{
+					const bgfx::ViewStats& viewStats = stats->viewStats[ii];
+					if (viewStats.view == m_shadowsView)
+					{
+						const uint32_t idx = 0 == (lastFrame / COMPARE_BLOCK_FRAMES) % 2 ? 0 : 1;
+						const double gpuMs = double(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin) * 1000.0 / double(stats->gpuTimerFreq);
+						m_compareTime[idx] += gpuMs;
+						++m_compareSamples[idx];
+						break;
+					}
+				}
+			}
+		}
+
+		++m_compareFrame;
+	}
+
+	uint32_t benchmarkConfigCount() const
+	{
+		return BX_COUNTOF(s_benchmarkResolutions)
+			* BX_COUNTOF(s_shadowStepBuckets)
+			* SHADOWS_VARIANT_MODES
+			* SHADOWS_VARIANT_RADIUS
+			;
+	}
+
+	// 0 to 1 over frames of one configuration
+	float benchmarkProgress() const
+	{
+		return float(m_benchmarkFrame) / float(BENCHMARK_WARMUP_FRAMES + m_benchmarkFrames);
+	}
+
+	bool beginBenchmark(const char* _path)
+	{
+		if (!bx::open(&m_benchmarkWriter, _path) )
+		{
+			DBG("Failed to open benchmark output %s", _path);
+			return false;
+		}
+
+		bx::writePrintf(&m_benchmarkWriter, "renderer,width,height,steps,contact_mode,screen_space_radius,compute,frames,frame_cpu_ms,submit_cpu_ms");
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_benchmarkViews); ++ii)
+		{
+			bx::writePrintf(&m_benchmarkWriter, ",%s_gpu_ms,%s_cpu_ms", s_benchmarkViews[ii].m_column, s_benchmarkViews[ii].m_column);
+		}
+		bx::writePrintf(&m_benchmarkWriter, "\n");
+
+		m_useSpecialisedShadows = true;
+		m_compareShaders = false;
+		m_benchmarkConfig = 0;
+		m_benchmarkFrame = 0;
+		resetBenchmarkTimes();
+		return true;
+	}
+
+	void resetBenchmarkTimes()
+	{
+		m_benchmarkFrameCpu = 0.0;
+		m_benchmarkSubmitCpu = 0.0;
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_benchmarkViews); ++ii)
+		{
+			m_benchmarkViewGpu[ii] = 0.0;
+			m_benchmarkViewCpu[ii] = 0.0;
+		}
+	}
+
+	// set shadow options and resolution for current configuration, ordered
+	// so consecutive configurations mostly change shader, not framebuffers
+	void applyBenchmarkConfig()
+	{
+		uint32_t idx = m_benchmarkConfig;
+		m_useScreenSpaceRadius = 0 != idx % SHADOWS_VARIANT_RADIUS;
+		idx /= SHADOWS_VARIANT_RADIUS;
+		m_contactShadowsMode = int32_t(idx % SHADOWS_VARIANT_MODES);
+		idx /= SHADOWS_VARIANT_MODES;
+		m_shadowSteps = s_shadowStepBuckets[idx % BX_COUNTOF(s_shadowStepBuckets)];
+		idx /= BX_COUNTOF(s_shadowStepBuckets);
+
+		const uint16_t* resolution = s_benchmarkResolutions[idx];
+		if (m_width  != resolution[0]
+		||  m_height != resolution[1])
+		{
+			m_width  = resolution[0];
+			m_height = resolution[1];
+			bgfx::reset(m_width, m_height, m_reset);
+		}
+	}
+
+	// collect stats of last frame, write a csv row when a configuration is
+	// done, and return false once every configuration has been measured
+	bool updateBenchmark()
+	{
+		if (BENCHMARK_WARMUP_FRAMES < m_benchmarkFrame)
+		{
+			const bgfx::Stats* stats = bgfx::getStats();
+			const double toCpuMs = 0 < stats->cpuTimerFreq ? 1000.0 / double(stats->cpuTimerFreq) : 0.0;
+			const double toGpuMs = 0 < stats->gpuTimerFreq ? 1000.0 / double(stats->gpuTimerFreq) : 0.0;
+
+			m_benchmarkFrameCpu += double(stats->cpuTimeFrame) * toCpuMs;
+			m_benchmarkSubmitCpu += double(m_submitTime) * 1000.0 / double(bx::getHPFrequency() );
+			for (uint16_t ii = 0; ii < stats->numViews; ++ii)
+			{
+				const bgfx::ViewStats& viewStats = stats->viewStats[ii];
+				for (uint32_t jj = 0; jj < BX_COUNTOF(s_benchmarkViews); ++jj)
+				{
+					if (0 == bx::strCmp(viewStats.name, s_benchmarkViews[jj].m_name) )
+					{
+						m_benchmarkViewGpu[jj] += double(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin) * toGpuMs;
+						m_benchmarkViewCpu[jj] += double(viewStats.cpuTimeEnd - viewStats.cpuTimeBegin) * toCpuMs;
+					}
+				}
+			}
+		}
+
+		++m_benchmarkFrame;
+		if (BENCHMARK_WARMUP_FRAMES + m_benchmarkFrames < m_benchmarkFrame)
+		{
+			const double frames = double(m_benchmarkFrames);
+			bx::writePrintf(&m_benchmarkWriter, "%s,%d,%d,%d,%d,%d,%d,%d,%f,%f"
+				, bgfx::getRendererName(bgfx::getRendererType() )
+				, m_width
+				, m_height
+				, m_shadowSteps
+				, m_contactShadowsMode
+				, m_useScreenSpaceRadius ? 1 : 0
+				, m_useComputeShadows ? 1 : 0
+				, m_benchmarkFrames
+				, m_benchmarkFrameCpu / frames
+				, m_benchmarkSubmitCpu / frames
+				);
+			for (uint32_t ii = 0; ii < BX_COUNTOF(s_benchmarkViews); ++ii)
+			{
+				bx::writePrintf(&m_benchmarkWriter, ",%f,%f", m_benchmarkViewGpu[ii] / frames, m_benchmarkViewCpu[ii] / frames);
+			}
+			bx::writePrintf(&m_benchmarkWriter, "\n");
+
+			resetBenchmarkTimes();
+			m_benchmarkFrame = 0;
+			++m_benchmarkConfig;
+			if (benchmarkConfigCount() <= m_benchmarkConfig)
+			{
+				bx::close(&m_benchmarkWriter);
+				m_benchmark = false;
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// append last frame's timings of each profiled view
+	void updateProfiler()
+	{
+		const bgfx::Stats* stats = bgfx::getStats();
+		const double toCpuMs = 0 < stats->cpuTimerFreq ? 1000.0 / double(stats->cpuTimerFreq) : 0.0;
+		const double toGpuMs = 0 < stats->gpuTimerFreq ? 1000.0 / double(stats->gpuTimerFreq) : 0.0;
+
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_profilerViews); ++ii)
+		{
+			m_profilerViews[ii].m_active = false;
+		}
+
+		for (uint16_t ii = 0; ii < stats->numViews; ++ii)
+		{
+			const bgfx::ViewStats& viewStats = stats->viewStats[ii];
+			for (uint32_t jj = 0; jj < BX_COUNTOF(s_profilerViews); ++jj)
+			{
+				if (0 == bx::strCmp(viewStats.name, s_profilerViews[jj]) )
+				{
+					m_profilerViews[jj].push(
+						  float(double(viewStats.gpuTimeEnd - viewStats.gpuTimeBegin) * toGpuMs)
+						, float(double(viewStats.cpuTimeEnd - viewStats.cpuTimeBegin) * toCpuMs)
+						);
+					m_profilerViews[jj].m_active = true;
+				}
+			}
+		}
+
+		m_profilerDraws = stats->numDraw;
+		m_profilerComputes = stats->numCompute;
+	}
+
+	void showProfiler()
+	{
+		ImGui::Text("draws: %d, dispatches: %d", m_profilerDraws, m_profilerComputes);
+		ImGui::Text("uniform uploads: %d (%d bytes)"
+			, m_uniformSubmits
+			, m_uniformBytes
+			);
+		ImGui::Text("graph passes: %d of %d, transient targets: %d in %d"
+			, m_graph.getNumActivePasses()
+			, m_graph.getNumPasses()
+			, m_graph.getNumTransientTargets()
+			, m_graph.getNumPooledTargets()
+			);
+		ImGui::Text("target pool: %d targets (%.1f MB)"
+			, m_graph.getPool().getNumTargets()
+			, double(m_graph.getPool().getMemory() ) / (1024.0 * 1024.0)
+			);
+		ImGui::Text("min/avg/max ms over last %d frames", PROFILER_HISTORY);
+
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_profilerViews); ++ii)
+		{
+			const ProfilerView& profilerView = m_profilerViews[ii];
+			if (!profilerView.m_active)
+			{
+				continue;
+			}
+
+			float gpuMin, gpuAvg, gpuMax;
+			float cpuMin, cpuAvg, cpuMax;
+			ProfilerView::summary(profilerView.m_gpu, profilerView.m_count, gpuMin, gpuAvg, gpuMax);
+			ProfilerView::summary(profilerView.m_cpu, profilerView.m_count, cpuMin, cpuAvg, cpuMax);
+
+			ImGui::Text("%s", s_profilerViews[ii]);
+			ImGui::Text("  gpu %.3f / %.3f / %.3f", gpuMin, gpuAvg, gpuMax);
+			ImGui::Text("  cpu %.3f / %.3f / %.3f", cpuMin, cpuAvg, cpuMax);
+
+			ImGui::PushID(s_profilerViews[ii]);
+			ImGui::PlotLines(""
+				, profilerView.m_gpu
+				, int32_t(profilerView.m_count)
+				, profilerView.plotOffset()
+				, NULL
+				, 0.0f
+				, gpuMax
+				, ImVec2(ImGui::GetWindowWidth() * 0.8f, 30.0f)
+				);
+			ImGui::PopID();
+		}
+
+		if (ImGui::Button("dump snapshot") )
+		{
+			char path[64];
+			bx::snprintf(path, sizeof(path), "sss_profile_%u.txt", m_currFrame);
+			dumpProfilerSnapshot(path);
+		}
+		if (ImGui::IsItemHovered())
+			ImGui::SetTooltip("write settings and timings to sss_profile_<frame>.txt");
+	}
+
+	void dumpProfilerSnapshot(const char* _path)
+	{
+		bx::FileWriter writer;
+		if (!bx::open(&writer, _path) )
+		{
+			DBG("Failed to open profiler snapshot %s", _path);
+			return;
+		}
+
+		bx::writePrintf(&writer, "renderer: %s\n", bgfx::getRendererName(bgfx::getRendererType() ) );
+		bx::writePrintf(&writer, "resolution: %dx%d, trace: %dx%d, dynamic: %d %dx%d steps %d\n"
+			, m_width
+			, m_height
+			, m_traceSize[0]
+			, m_traceSize[1]
+			, m_useDynamicResolution ? 1 : 0
+			, m_scaledTraceSize[0]
+			, m_scaledTraceSize[1]
+			, dynamicShadowSteps()
+			);
+		bx::writePrintf(&writer, "steps: %d, contact shadows mode: %d, radius: %f %s\n"
+			, m_shadowSteps
+			, m_contactShadowsMode
+			, m_useScreenSpaceRadius ? m_shadowRadiusPixels : m_shadowRadius
+			, m_useScreenSpaceRadius ? "pixels" : "world units"
+			);
+		bx::writePrintf(&writer, "compute: %d, hi-z: %d, temporal: %d, specialised: %d, lights: %d, adaptive steps: %d, screen space march: %d\n"
+			, m_useComputeShadows ? 1 : 0
+			, useHiZ() ? 1 : 0
+			, m_useTemporal ? 1 : 0
+			, m_useSpecialisedShadows ? 1 : 0
+			, m_lightCount
+			, m_useAdaptiveSteps ? 1 : 0
+			, m_useScreenSpaceMarch ? 1 : 0
+			);
+		bx::writePrintf(&writer, "depth source: %d, gbuffer layout: %d, reversed z: %d\n"
+			, m_activeDepthSource
+			, m_activeGbufferLayout
+			, m_activeReversedZ ? 1 : 0
+			);
+		bx::writePrintf(&writer, "random offset: %d, blue noise: %d, denoise: %d\n"
+			, m_useNoiseOffset ? 1 : 0
+			, useBlueNoise() ? 1 : 0
+			, m_useDenoise ? 1 : 0
+			);
+		bx::writePrintf(&writer, "models: %d, instancing: %d, submit threads: %d, baked meshes: %d\n"
+			, m_modelCount
+			, m_useInstancing ? 1 : 0
+			, m_submitThreads
+			, m_useBakedMeshes ? 1 : 0
+			);
+		bx::writePrintf(&writer, "sorted: %d, depth prepass: %d, overdraw: %.2f per pixel, %.2f per covered pixel\n"
+			, m_modelsSorted ? 1 : 0
+			, m_useDepthPrepass ? 1 : 0
+			, m_overdrawPerPixel
+			, m_overdrawPerCovered
+			);
+		bx::writePrintf(&writer, "clustered lighting: %d, point lights: %d, light indices: %u\n"
+			, useClusteredLighting() ? 1 : 0
+			, m_pointLightCount
+			, m_clusterIndexCount
+			);
+		bx::writePrintf(&writer, "draws: %d, dispatches: %d, uniform uploads: %d (%d bytes)\n"
+			, m_profilerDraws
+			, m_profilerComputes
+			, m_uniformSubmits
+			, m_uniformBytes
+			);
+		bx::writePrintf(&writer, "graph passes: %d of %d, transient targets: %d in %d, target pool: %d (%.1f MB)\n\n"
+			, m_graph.getNumActivePasses()
+			, m_graph.getNumPasses()
+			, m_graph.getNumTransientTargets()
+			, m_graph.getNumPooledTargets()
+			, m_graph.getPool().getNumTargets()
+			, double(m_graph.getPool().getMemory() ) / (1024.0 * 1024.0)
+			);
+
+		bx::writePrintf(&writer, "view, gpu min, gpu avg, gpu max, cpu min, cpu avg, cpu max\n");
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_profilerViews); ++ii)
+		{
+			const ProfilerView& profilerView = m_profilerViews[ii];
+			if (!profilerView.m_active)
+			{
+				continue;
+			}
+
+			float gpuMin, gpuAvg, gpuMax;
+			float cpuMin, cpuAvg, cpuMax;
+			ProfilerView::summary(profilerView.m_gpu, profilerView.m_count, gpuMin, gpuAvg, gpuMax);
+			ProfilerView::summary(profilerView.m_cpu, profilerView.m_count, cpuMin, cpuAvg, cpuMax);
+			bx::writePrintf(&writer, "%s, %f, %f, %f, %f, %f, %f\n"
+				, s_profilerViews[ii]
+				, gpuMin, gpuAvg, gpuMax
+				, cpuMin, cpuAvg, cpuMax
+				);
+		}
+
+		bx::close(&writer);
+	}
+
+	// blit full resolution depth and shadows into readback textures, and
+	// capture the uniforms they were traced with. Depth is read back as the
+	// shadows pass sampled it, hardware depth is linearized by the reference
+	void requestValidation(bgfx::ViewId _view, bgfx::TextureHandle _depth, bgfx::TextureHandle _shadows)
+	{
+		m_validationRequested = false;
+
+		const uint32_t numPixels = uint32_t(m_size[0] * m_size[1]);
+		if (m_validationPixels != numPixels)
+		{
+			freeValidation();
+			m_validationPixels = numPixels;
+			m_readbackShadowsData = (uint8_t*)BX_ALLOC(entry::getAllocator(), numPixels * MAX_LIGHTS);
+			m_validationDepth = (float*)BX_ALLOC(entry::getAllocator(), numPixels * sizeof(float) );
+			m_validationShadows = (float*)BX_ALLOC(entry::getAllocator(), numPixels * MAX_LIGHTS * sizeof(float) );
+		}
+
+		bgfx::blit(_view, m_readbackDepth, 0, 0, _depth);
+		bgfx::blit(_view, m_readbackShadows, 0, 0, _shadows);
+		const uint32_t depthFrame = bgfx::readTexture(m_readbackDepth, m_validationDepth);
+		const uint32_t shadowsFrame = bgfx::readTexture(m_readbackShadows, m_readbackShadowsData);
+		m_readbackFrame = bx::max(depthFrame, shadowsFrame);
+
+		sss::ReferenceParams& params = m_validationParams;
+		params.m_depth = m_validationDepth;
+		params.m_width = uint32_t(m_size[0]);
+		params.m_height = uint32_t(m_size[1]);
+		params.m_depthIsHardware = m_depthIsHardware;
+		bx::memCopy(params.m_depthUnpackConsts, m_uniforms.m_depthUnpackConsts, sizeof(params.m_depthUnpackConsts) );
+		bx::memCopy(params.m_viewToProj, m_uniforms.m_viewToProj, sizeof(params.m_viewToProj) );
+		bx::memCopy(params.m_ndcToViewMul, m_uniforms.m_ndcToViewMul, sizeof(params.m_ndcToViewMul) );
+		bx::memCopy(params.m_ndcToViewAdd, m_uniforms.m_ndcToViewAdd, sizeof(params.m_ndcToViewAdd) );
+		for (uint32_t ii = 0; ii < MAX_LIGHTS; ++ii)
+		{
+			bx::memCopy(params.m_lightPosition[ii], m_uniforms.m_lightPosition[ii], 3*sizeof(float) );
+		}
+		params.m_lightCount = uint32_t(m_lightCount);
+		params.m_shadowRadius = m_uniforms.m_shadowRadius;
+		params.m_useScreenSpaceRadius = m_useScreenSpaceRadius;
+		params.m_shadowSteps = uint32_t(m_shadowSteps);
+		params.m_contactShadowsMode = uint32_t(m_contactShadowsMode);
+		params.m_useNoiseOffset = m_useNoiseOffset;
+		params.m_frameIdx = m_uniforms.m_frameIdx;
+		params.m_useBlueNoise = useBlueNoise();
+		params.m_blueNoise = m_blueNoiseLoaded ? m_blueNoise : NULL;
+		params.m_blueNoiseSize = BLUE_NOISE_SIZE;
+	}
+
+	// run cpu reference on read back depth, and measure error of gpu shadows
+	void runValidation()
+	{
+		m_readbackFrame = UINT32_MAX;
+
+		const sss::ReferenceParams& params = m_validationParams;
+		const uint32_t numPixels = params.m_width * params.m_height;
+
+		const int64_t start = bx::getHPCounter();
+		sss::referenceShadows(params, m_validationShadows, REFERENCE_THREADS);
+		m_validationTime = float(double(bx::getHPCounter() - start) * 1000.0 / double(bx::getHPFrequency() ) );
+
+		for (uint32_t light = 0; light < params.m_lightCount; ++light)
+		{
+			double sumError = 0.0;
+			float maxError = 0.0f;
+			uint32_t mismatches = 0;
+			for (uint32_t ii = 0; ii < numPixels; ++ii)
+			{
+				const float gpu = float(m_readbackShadowsData[ii * MAX_LIGHTS + light]) / 255.0f;
+				const float cpu = m_validationShadows[ii * MAX_LIGHTS + light];
+				const float error = bx::abs(gpu - cpu);
+				sumError += error;
+				maxError = bx::max(maxError, error);
+				mismatches += VALIDATION_MISMATCH < error ? 1 : 0;
+			}
+
+			m_validationMeanError[light] = float(sumError / double(numPixels) );
+			m_validationMaxError[light] = maxError;
+			m_validationMismatch[light] = 100.0f * float(mismatches) / float(numPixels);
+		}
+
+		m_validationDone = true;
+	}
+
+	void freeValidation()
+	{
+		if (0 != m_validationPixels)
+		{
+			BX_FREE(entry::getAllocator(), m_readbackShadowsData);
+			BX_FREE(entry::getAllocator(), m_validationDepth);
+			BX_FREE(entry::getAllocator(), m_validationShadows);
+			m_validationPixels = 0;
+		}
+	}
+
+	// blit gbuffer color, which holds fragments shaded per pixel while
+	// displaying overdraw, into readback texture
+	void requestOverdraw(bgfx::ViewId _view)
+	{
+		const uint32_t numPixels = uint32_t(m_size[0] * m_size[1]);
+		if (m_overdrawPixels != numPixels)
+		{
+			if (NULL != m_overdrawData)
+			{
+				BX_FREE(entry::getAllocator(), m_overdrawData);
+			}
+			m_overdrawData = (uint8_t*)BX_ALLOC(entry::getAllocator(), numPixels * 4);
+			m_overdrawPixels = numPixels;
+		}
+
+		bgfx::blit(_view, m_readbackOverdraw, 0, 0, m_gbufferTex[GBUFFER_RT_COLOR]);
+		m_overdrawFrame = bgfx::readTexture(m_readbackOverdraw, m_overdrawData);
+	}
+
+	// count is the same in every channel, saturating at 255
+	void updateOverdraw()
+	{
+		m_overdrawFrame = UINT32_MAX;
+
+		uint64_t fragments = 0;
+		uint32_t covered = 0;
+		for (uint32_t ii = 0; ii < m_overdrawPixels; ++ii)
+		{
+			const uint8_t count = m_overdrawData[ii * 4];
+			fragments += count;
+			covered += 0 < count ? 1 : 0;
+		}
+
+		m_overdrawPerPixel = float(double(fragments) / double(bx::max(m_overdrawPixels, 1u) ) );
+		m_overdrawPerCovered = float(double(fragments) / double(bx::max(covered, 1u) ) );
+	}
+
+	struct SubmitModelsJob
+	{
+		const ExampleScreenSpaceShadows* m_app;
+		bgfx::ViewId m_pass;
+		bgfx::ProgramHandle m_program;
+		uint64_t m_state;
+		const Uniforms* m_uniforms;
+		uint32_t m_numJobs;
+	};
+
+	static void submitModelsJob(void* _userData, uint32_t _jobIdx, uint32_t _threadIdx)
+	{
+		BX_UNUSED(_threadIdx);
+		const SubmitModelsJob& job = *(const SubmitModelsJob*)_userData;
+		const ExampleScreenSpaceShadows& app = *job.m_app;
+
+		bgfx::Encoder* encoder = bgfx::begin(true);
+		if (NULL == encoder)
+		{
+			return;
+		}
+
+		job.m_uniforms->submit(encoder);
+
+		const uint32_t first = uint32_t(app.m_modelCount) * _jobIdx / job.m_numJobs;
+		const uint32_t last = uint32_t(app.m_modelCount) * (_jobIdx + 1) / job.m_numJobs;
+		for (uint32_t ii = first; ii < last; ++ii)
+		{
+			const Model& model = app.m_models[app.m_modelsSorted ? app.m_modelOrder[ii] : ii];
+			if (NULL == app.m_meshes[model.mesh])
+			{
+				continue;
+			}
+
+			float mtx[16];
+			app.modelMtx(mtx, model.mesh, model.position);
+
+			encoder->setTexture(0, app.s_albedo, app.m_groundTexture);
+			encoder->setTexture(1, app.s_normal, app.m_normalTexture);
+
+			meshSubmit(encoder, app.m_meshes[model.mesh], job.m_pass, job.m_program, mtx, job.m_state);
+		}
+
+		bgfx::end(encoder);
+	}
+
+	// Average model submit time for each thread count, stepping through
+	// powers of two and max
+	void updateScaling()
+	{
+		++m_scalingFrame;
+		if (SCALING_SETTLE_FRAMES < m_scalingFrame)
+		{
+			m_scalingTime += m_modelSubmitTime;
+		}
+
+		if (SCALING_SETTLE_FRAMES + SCALING_FRAMES > m_scalingFrame)
+		{
+			return;
+		}
+
+		m_scalingThreads[m_scalingCount] = m_submitThreads;
+		m_scalingMs[m_scalingCount] = float(double(m_scalingTime) * 1000.0 / double(bx::getHPFrequency() ) / double(SCALING_FRAMES) );
+		++m_scalingCount;
+
+		m_scalingFrame = 0;
+		m_scalingTime = 0;
+		if (int32_t(m_maxSubmitThreads) == m_submitThreads)
+		{
+			m_scalingStep = -1;
+			m_submitThreads = m_scalingPrevThreads;
+			return;
+		}
+
+		++m_scalingStep;
+		m_submitThreads = bx::min(1 << m_scalingStep, int32_t(m_maxSubmitThreads) );
+	}
+
+	static Mesh* loadMeshFile(bx::FileReaderI* _reader, const char* _filePath)
+	{
+		Mesh* mesh = NULL;
+		if (bx::open(_reader, _filePath) )
+		{
+			mesh = meshLoad(_reader);
+			bx::close(_reader);
+		}
+		return mesh;
+	}
+
+	// Load source mesh with ram copy and write it in baked format
+	static bool bakeMeshFile(bx::FileReaderI* _reader, const char* _filePath, const char* _bakedPath)
+	{
+		if (!bx::open(_reader, _filePath) )
+		{
+			return false;
+		}
+
+		const bool ramcopy = true;
+		Mesh* source = meshLoad(_reader, ramcopy);
+		bx::close(_reader);
+
+		const bool baked = NULL != source && sss::bakeMesh(source, _bakedPath, _filePath);
+		meshUnload(source);
+		return baked;
+	}
+
+	// Baked file is written from source mesh when missing, from another
+	// version or from a source mesh that changed since, so every mesh has the
+	// baked layout
+	static Mesh* loadBakedMeshFile(bx::FileReaderI* _reader, const char* _filePath, float* _dequantize)
+	{
+		char bakedPath[256];
+		sss::bakedMeshPath(bakedPath, sizeof(bakedPath), _filePath);
+
+		Mesh* mesh = sss::bakedMeshLoad(bakedPath, _filePath, _dequantize);
+		if (NULL == mesh
+		&&  bakeMeshFile(_reader, _filePath, bakedPath) )
+		{
+			DBG("Rebaked %s", bakedPath);
+			mesh = sss::bakedMeshLoad(bakedPath, _filePath, _dequantize);
+		}
+		return mesh;
+	}
+
+	// Converter for --bake-meshes, writes baked file of every mesh
+	void bakeMeshes()
+	{
+		bx::FileReader reader;
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths) + 1; ++ii)
+		{
+			const char* filePath = ii < BX_COUNTOF(s_meshPaths) ? s_meshPaths[ii] : s_groundMeshPath;
+			char bakedPath[256];
+			sss::bakedMeshPath(bakedPath, sizeof(bakedPath), filePath);
+
+			const bool baked = bakeMeshFile(&reader, filePath, bakedPath);
+			DBG("%s %s", baked ? "Baked" : "Failed to bake", bakedPath);
+		}
+	}
+
+	// bgfx parses dds and other containers itself
+	static bgfx::TextureHandle loadTextureFile(bx::FileReaderI* _reader, const char* _filePath)
+	{
+		bgfx::TextureHandle handle = BGFX_INVALID_HANDLE;
+		if (bx::open(_reader, _filePath) )
+		{
+			const uint32_t size = uint32_t(bx::getSize(_reader) );
+			const bgfx::Memory* mem = bgfx::alloc(size);
+			bx::read(_reader, mem->data, int32_t(size) );
+			bx::close(_reader);
+			handle = bgfx::createTexture(mem);
+		}
+		return handle;
+	}
+
+	// Runs on loader thread. File reads, parsing and creating buffers happen
+	// here, bgfx resource creation is thread safe. Each job opens files with
+	// its own reader, entry's reader is used by main thread
+	static void loadAssetJob(void* _userData, uint32_t _jobIdx)
+	{
+		ExampleScreenSpaceShadows& app = *(ExampleScreenSpaceShadows*)_userData;
+		bx::FileReader reader;
+
+		if (LOAD_GROUND == _jobIdx)
+		{
+			app.m_loadedGround = app.m_useBakedMeshes
+				? loadBakedMeshFile(&reader, s_groundMeshPath, app.m_loadedGroundDequantize)
+				: loadMeshFile(&reader, s_groundMeshPath)
+				;
+		}
+		else if (LOAD_GROUND_TEXTURE == _jobIdx)
+		{
+			app.m_loadedGroundTexture = loadTextureFile(&reader, s_groundTexturePath);
+		}
+		else if (LOAD_NORMAL_TEXTURE == _jobIdx)
+		{
+			app.m_loadedNormalTexture = loadTextureFile(&reader, s_normalTexturePath);
+		}
+		else if (LOAD_BLUE_NOISE == _jobIdx)
+		{
+			// tiled by wrapping with point sampling, values are kept for cpu
+			// reference too
+			sss::blueNoise(entry::getAllocator(), app.m_blueNoise, BLUE_NOISE_SIZE, BLUE_NOISE_SEED);
+			app.m_loadedBlueNoiseTexture = bgfx::createTexture2D(BLUE_NOISE_SIZE, BLUE_NOISE_SIZE, false, 1, bgfx::TextureFormat::R8, BGFX_SAMPLER_POINT, bgfx::copy(app.m_blueNoise, sizeof(app.m_blueNoise) ) );
+		}
+		else
+		{
+			const uint32_t mesh = _jobIdx - LOAD_FIRST_MESH;
+			app.m_loadedMeshes[mesh] = app.m_useBakedMeshes
+				? loadBakedMeshFile(&reader, s_meshPaths[mesh], app.m_loadedMeshDequantize[mesh])
+				: loadMeshFile(&reader, s_meshPaths[mesh])
+				;
+		}
+	}
+
+	// Take results of jobs finished since last call, replacing placeholders
+	void updateLoading()
+	{
+		const uint32_t numFinished = m_loader.getNumFinished();
+		bool updateInstances = false;
+		for (uint32_t ii = m_numLoaded; ii < numFinished; ++ii)
+		{
+			if (LOAD_GROUND == ii)
+			{
+				m_ground = m_loadedGround;
+				if (NULL != m_ground
+				&&  m_useBakedMeshes)
+				{
+					bx::memCopy(m_groundDequantize, m_loadedGroundDequantize, sizeof(m_groundDequantize) );
+				}
+			}
+			else if (LOAD_GROUND_TEXTURE == ii
+			     ||  LOAD_NORMAL_TEXTURE == ii)
+			{
+				bgfx::TextureHandle& texture = LOAD_GROUND_TEXTURE == ii ? m_groundTexture : m_normalTexture;
+				const bgfx::TextureHandle loaded = LOAD_GROUND_TEXTURE == ii ? m_loadedGroundTexture : m_loadedNormalTexture;
+				if (bgfx::isValid(loaded) )
+				{
+					bgfx::destroy(texture);
+					texture = loaded;
+				}
+			}
+			else if (LOAD_BLUE_NOISE == ii)
+			{
+				if (bgfx::isValid(m_loadedBlueNoiseTexture) )
+				{
+					bgfx::destroy(m_blueNoiseTexture);
+					m_blueNoiseTexture = m_loadedBlueNoiseTexture;
+					m_blueNoiseLoaded = true;
+				}
+			}
+			else
+			{
+				const uint32_t mesh = ii - LOAD_FIRST_MESH;
+				m_meshes[mesh] = m_loadedMeshes[mesh];
+				if (NULL != m_meshes[mesh]
+				&&  m_useBakedMeshes)
+				{
+					bx::memCopy(m_meshDequantize[mesh], m_loadedMeshDequantize[mesh], sizeof(m_meshDequantize[mesh]) );
+					updateInstances = true;
+				}
+			}
+		}
+		m_numLoaded = numFinished;
+
+		if (updateInstances)
+		{
+			createInstanceBuffer();
+		}
+
+		// indirect draws need groups of every mesh
+		if (!m_assetsLoaded
+		&&  m_loader.getNumJobs() == m_numLoaded)
+		{
+			m_assetsLoaded = true;
+			bool allMeshes = true;
+			for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
+			{
+				allMeshes = allMeshes && NULL != m_meshes[ii];
+			}
+			if (m_cullingSupported && allMeshes)
+			{
+				createCullBuffers();
+			}
+
+			const double freq = double(bx::getHPFrequency() );
+			DBG("Assets loaded after %.1f ms", double(bx::getHPCounter() - m_initTime) * 1000.0 / freq);
+		}
+	}
+
+	// Bounding sphere of each mesh, one indirect draw per group of each mesh,
+	// and buffers written by cull pass
+	void createCullBuffers()
+	{
+		const bgfx::Memory* drawInfo = bgfx::alloc(CULL_MAX_DRAWS * 2 * sizeof(uint32_t) );
+		uint32_t* draws = (uint32_t*)drawInfo->data;
+		bx::memSet(draws, 0, drawInfo->size);
+
+		m_cullDrawCount = 0;
+		for (uint32_t ii = 0; ii < CULL_MESH_COUNT; ++ii)
+		{
+			const Mesh* mesh = m_meshes[ii];
+
+			// sphere around spheres of all groups
+			bx::Vec3 center = { 0.0f, 0.0f, 0.0f };
+			for (GroupArray::const_iterator it = mesh->m_groups.begin(), itEnd = mesh->m_groups.end(); it != itEnd; ++it)
+			{
+				center = bx::add(center, it->m_sphere.center);
+			}
+			center = bx::mul(center, 1.0f / float(bx::max(uint32_t(mesh->m_groups.size() ), 1u) ) );
+
+			float radius = 0.0f;
+			for (GroupArray::const_iterator it = mesh->m_groups.begin(), itEnd = mesh->m_groups.end(); it != itEnd; ++it)
+			{
+				radius = bx::max(radius, bx::length(bx::sub(it->m_sphere.center, center) ) + it->m_sphere.radius);
+			}
+			vec4Set(m_meshBounds[ii], center.x, center.y, center.z, radius);
+
+			m_meshFirstDraw[ii] = m_cullDrawCount;
+			for (uint32_t group = 0; group < uint32_t(mesh->m_groups.size() ); ++group)
+			{
+				BX_ASSERT(m_cullDrawCount < CULL_MAX_DRAWS, "Too many mesh groups for cs_sss_cull_draws");
+				draws[m_cullDrawCount * 2 + 0] = ii;
+				draws[m_cullDrawCount * 2 + 1] = mesh->m_groups[group].m_numIndices;
+				++m_cullDrawCount;
+			}
+		}
+
+		m_drawInfo = bgfx::createIndexBuffer(drawInfo
+			, BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_INDEX32 | BGFX_BUFFER_COMPUTE_FORMAT_32X1 | BGFX_BUFFER_COMPUTE_TYPE_UINT
+			);
+
+		// counts start at zero, cull draws pass resets them every frame
+		const bgfx::Memory* meshCounts = bgfx::alloc(CULL_MESH_COUNT * sizeof(uint32_t) );
+		bx::memSet(meshCounts->data, 0, meshCounts->size);
+		m_meshCounts = bgfx::createDynamicIndexBuffer(meshCounts
+			, BGFX_BUFFER_COMPUTE_READ_WRITE | BGFX_BUFFER_INDEX32 | BGFX_BUFFER_COMPUTE_FORMAT_32X1 | BGFX_BUFFER_COMPUTE_TYPE_UINT
+			);
+
+		m_culledInstances = bgfx::createDynamicVertexBuffer(MAX_MODEL_COUNT
+			, InstanceData::ms_layout
+			, BGFX_BUFFER_COMPUTE_WRITE | BGFX_BUFFER_COMPUTE_FORMAT_32X4 | BGFX_BUFFER_COMPUTE_TYPE_FLOAT
+			);
+		m_indirect = bgfx::createIndirectBuffer(CULL_MAX_DRAWS);
+	}
+
+	// Frustum of this frame's camera, and previous frame's matrices for
+	// testing against depth pyramid built last frame
+	void updateCullUniforms()
+	{
+		float viewProj[16];
+		bx::mtxMul(viewProj, m_view, m_proj);
+
+		// column j of viewProj gives clip component j
+		const bool homogeneousDepth = bgfx::getCaps()->homogeneousDepth;
+		for (uint32_t ii = 0; ii < 6; ++ii)
+		{
+			const uint32_t axis = ii / 2;
+			const float sign = (0 == ii % 2) ? 1.0f : -1.0f;
+			const float wScale = (4 == ii && !homogeneousDepth) ? 0.0f : 1.0f; // near is z >= 0 without homogeneous depth
+
+			float* plane = m_uniforms.m_frustumPlanes[ii];
+			for (uint32_t jj = 0; jj < 4; ++jj)
+			{
+				plane[jj] = wScale * viewProj[jj*4 + 3] + sign * viewProj[jj*4 + axis];
+			}
+
+			const float invLength = 1.0f / bx::length({ plane[0], plane[1], plane[2] });
+			for (uint32_t jj = 0; jj < 4; ++jj)
+			{
+				plane[jj] *= invLength;
+			}
+		}
+
+		for (uint32_t ii = 0; ii < 4; ++ii)
+		{
+			m_uniforms.m_meshInstanceStart[ii] = float(m_meshInstanceStart[ii + 1]);
+		}
+		bx::memCopy(m_uniforms.m_meshBounds, m_meshBounds, sizeof(m_meshBounds) );
+
+		m_uniforms.m_cullModelCount = float(m_modelCount);
+		m_uniforms.m_useOcclusionCulling = (useOcclusionCulling() && m_havePreviousHiZ) ? 1.0f : 0.0f;
+		m_uniforms.m_cullHiZMaxLevel = float(m_hizLevels - 1);
+		m_uniforms.m_cullDrawCount = float(m_cullDrawCount);
+		vec2Set(m_uniforms.m_cullDepthSize, float(m_size[0]), float(m_size[1]) );
+		m_uniforms.m_cameraNear = CAMERA_NEAR;
+		mat4Set(m_uniforms.m_worldToPrevView, m_prevView);
+		mat4Set(m_uniforms.m_prevViewToProj, m_prevProj);
+	}
+
+	// Generate m_modelCount models in an area growing with count, and sort
+	// them by mesh so each mesh is a contiguous range of instance buffer
+	void createModels()
+	{
+		const float spread = bx::sqrt(float(m_modelCount) / float(MODEL_COUNT) );
+		m_groundScale = 10.0f * bx::max(1.0f, spread);
+
+		Model* models = (Model*)BX_ALLOC(entry::getAllocator(), m_modelCount * sizeof(Model) );
+		bx::memSet(m_meshInstanceCount, 0, sizeof(m_meshInstanceCount) );
+
+		bx::RngMwc mwc;
+		for (int32_t ii = 0; ii < m_modelCount; ++ii)
+		{
+			Model& model = models[ii];
+
+			model.mesh = mwc.gen() % BX_COUNTOF(s_meshPaths);
+			model.position[0] = (((mwc.gen() % 256)) - 128.0f) / 20.0f * spread;
+			model.position[1] = 0;
+			model.position[2] = (((mwc.gen() % 256)) - 128.0f) / 20.0f * spread;
+			++m_meshInstanceCount[model.mesh];
+		}
+
+		uint32_t start = 0;
+		for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
+		{
+			m_meshInstanceStart[ii] = start;
+			start += m_meshInstanceCount[ii];
+		}
+
+		uint32_t next[BX_COUNTOF(s_meshPaths)];
+		bx::memCopy(next, m_meshInstanceStart, sizeof(next) );
+		for (int32_t ii = 0; ii < m_modelCount; ++ii)
+		{
+			const Model& model = models[ii];
+			m_models[next[model.mesh]++] = model;
+		}
+
+		BX_FREE(entry::getAllocator(), models);
+
+		createInstanceBuffer();
+		createPointLights();
+	}
+
+	// Small colored lights over area of models. Same seed, so changing count
+	// keeps existing lights in place
+	void createPointLights()
+	{
+		const float spread = bx::sqrt(float(m_modelCount) / float(MODEL_COUNT) );
+
+		bx::RngMwc mwc;
+		for (int32_t ii = 0; ii < MAX_POINT_LIGHTS; ++ii)
+		{
+			PointLight& light = m_pointLights[ii];
+			light.position[0] = (((mwc.gen() % 256)) - 128.0f) / 20.0f * spread;
+			light.position[1] = 0.2f + float(mwc.gen() % 256) / 512.0f;
+			light.position[2] = (((mwc.gen() % 256)) - 128.0f) / 20.0f * spread;
+			light.radius = 0.75f + float(mwc.gen() % 256) / 256.0f;
+
+			// dim, saturated colors
+			const float hue = float(mwc.gen() % 256) / 256.0f * 6.0f;
+			light.color[0] = 0.08f * bx::clamp(bx::abs(hue - 3.0f) - 1.0f, 0.0f, 1.0f);
+			light.color[1] = 0.08f * bx::clamp(2.0f - bx::abs(hue - 2.0f), 0.0f, 1.0f);
+			light.color[2] = 0.08f * bx::clamp(2.0f - bx::abs(hue - 4.0f), 0.0f, 1.0f);
+		}
+	}
+
+	bool useClusteredLighting() const
+	{
+		return m_clusteredSupported && m_useClusteredLighting;
+	}
+
+	// Light array is the shadow casting lights, each masking its channel of
+	// shadows, followed by point lights. Lists are rebuilt every frame from
+	// view space positions and uploaded as textures
+	void updateClusters()
+	{
+		const int64_t start = bx::getHPCounter();
+
+		sss::ClusterLight lights[SSS_CLUSTER_MAX_LIGHTS];
+		float* positionRadius = m_clusterLightData;
+		float* color = m_clusterLightData + SSS_CLUSTER_MAX_LIGHTS * 4;
+		float* shadowMask = m_clusterLightData + SSS_CLUSTER_MAX_LIGHTS * 8;
+		bx::memSet(m_clusterLightData, 0, SSS_CLUSTER_MAX_LIGHTS * 3 * 4 * sizeof(float) );
+
+		const uint32_t numLights = uint32_t(m_lightCount + m_pointLightCount);
+		for (uint32_t ii = 0; ii < numLights; ++ii)
+		{
+			sss::ClusterLight& light = lights[ii];
+			if (ii < uint32_t(m_lightCount) )
+			{
+				bx::memCopy(light.m_position, m_uniforms.m_lightPosition[ii], 3*sizeof(float) );
+				light.m_radius = SHADOW_LIGHT_RADIUS;
+				vec4Set(&color[ii * 4], 1.0f, 1.0f, 1.0f, 0.0f);
+				shadowMask[ii * 4 + ii] = 1.0f;
+			}
+			else
+			{
+				const PointLight& pointLight = m_pointLights[ii - m_lightCount];
+				const float position[4] = { pointLight.position[0], pointLight.position[1], pointLight.position[2], 1.0f };
+				float viewSpacePosition[4];
+				bx::vec4MulMtx(viewSpacePosition, position, m_view);
+				bx::memCopy(light.m_position, viewSpacePosition, 3*sizeof(float) );
+				light.m_radius = pointLight.radius;
+				vec4Set(&color[ii * 4], pointLight.color[0], pointLight.color[1], pointLight.color[2], 0.0f);
+			}
+
+			bx::memCopy(&positionRadius[ii * 4], light.m_position, 3*sizeof(float) );
+			positionRadius[ii * 4 + 3] = light.m_radius;
+		}
+
+		sss::ClusterParams params;
+		bx::memCopy(params.m_ndcToViewMul, m_uniforms.m_ndcToViewMul, sizeof(params.m_ndcToViewMul) );
+		bx::memCopy(params.m_ndcToViewAdd, m_uniforms.m_ndcToViewAdd, sizeof(params.m_ndcToViewAdd) );
+		params.m_near = CLUSTER_NEAR;
+		params.m_far = CAMERA_FAR;
+		sss::clusterDepthSlice(params, m_uniforms.m_clusterDepthScale, m_uniforms.m_clusterDepthBias);
+		m_clusterIndexCount = sss::buildClusters(params, lights, numLights, m_clusterData, m_clusterIndices);
+
+		// only rows of indices in use
+		const uint16_t indexRows = uint16_t(bx::max( (m_clusterIndexCount + SSS_CLUSTER_INDEX_WIDTH - 1) / SSS_CLUSTER_INDEX_WIDTH, 1u) );
+		bgfx::updateTexture2D(m_clusterTexture, 0, 0, 0, 0, SSS_CLUSTER_X * SSS_CLUSTER_Y, SSS_CLUSTER_Z
+			, bgfx::copy(m_clusterData, SSS_CLUSTER_COUNT * 2 * sizeof(float) )
+			);
+		bgfx::updateTexture2D(m_clusterLightTexture, 0, 0, 0, 0, SSS_CLUSTER_MAX_LIGHTS, 3
+			, bgfx::copy(m_clusterLightData, SSS_CLUSTER_MAX_LIGHTS * 3 * 4 * sizeof(float) )
+			);
+		bgfx::updateTexture2D(m_clusterIndexTexture, 0, 0, 0, 0, SSS_CLUSTER_INDEX_WIDTH, indexRows
+			, bgfx::copy(m_clusterIndices, indexRows * SSS_CLUSTER_INDEX_WIDTH * sizeof(float) )
+			);
+
+		m_clusterTime = bx::getHPCounter() - start;
+	}
+
+	// Instance data of sorted models. Depends on dequantization of baked
+	// meshes, so is created again as they are loaded
+	void createInstanceBuffer()
+	{
+		const bgfx::Memory* mem = bgfx::alloc(m_modelCount * sizeof(InstanceData) );
+		InstanceData* instances = (InstanceData*)mem->data;
+		for (int32_t ii = 0; ii < m_modelCount; ++ii)
+		{
+			const Model& model = m_models[ii];
+			const float* dequantize = m_meshDequantize[model.mesh];
+			const float scale = s_meshScale[model.mesh];
+
+			InstanceData& instance = instances[ii];
+			instance.m_x = model.position[0] + scale * dequantize[0];
+			instance.m_y = model.position[1] + scale * dequantize[1];
+			instance.m_z = model.position[2] + scale * dequantize[2];
+			instance.m_scale = scale * dequantize[3];
+		}
+
+		if (bgfx::isValid(m_instanceBuffer) )
+		{
+			bgfx::destroy(m_instanceBuffer);
+		}
+		const uint16_t instanceFlags = m_cullingSupported
+			? BGFX_BUFFER_COMPUTE_READ | BGFX_BUFFER_COMPUTE_FORMAT_32X4 | BGFX_BUFFER_COMPUTE_TYPE_FLOAT
+			: BGFX_BUFFER_NONE
+			;
+		m_instanceBuffer = bgfx::createVertexBuffer(mem, InstanceData::ms_layout, instanceFlags);
+	}
+
+	// Keys are view depth as float bits, which sort like the floats they hold
+	// when not negative. Models behind camera are clamped to zero
+	void sortModels()
+	{
+		const int64_t start = bx::getHPCounter();
+		for (int32_t ii = 0; ii < m_modelCount; ++ii)
+		{
+			const float* position = m_models[ii].position;
+			const float depth = position[0] * m_view[2] + position[1] * m_view[6] + position[2] * m_view[10] + m_view[14];
+			m_sortKeys[ii] = bx::floatToBits(bx::max(depth, 0.0f) );
+			m_modelOrder[ii] = uint32_t(ii);
+		}
+		bx::radixSort(m_sortKeys, m_sortTempKeys, m_modelOrder, m_sortTempOrder, uint32_t(m_modelCount) );
+		m_modelSortTime = bx::getHPCounter() - start;
+	}
+
+	// Uniform scale and translation of a model. Baked meshes store positions
+	// relative to their bounds, which is folded in here
+	void modelMtx(float* _mtx, uint32_t _mesh, const float* _position) const
+	{
+		const float* dequantize = m_meshDequantize[_mesh];
+		const float scale = s_meshScale[_mesh];
+		bx::mtxSRT(_mtx
+			, scale * dequantize[3]
+			, scale * dequantize[3]
+			, scale * dequantize[3]
+			, 0.0f
+			, 0.0f
+			, 0.0f
+			, _position[0] + scale * dequantize[0]
+			, _position[1] + scale * dequantize[1]
+			, _position[2] + scale * dequantize[2]
+			);
+	}
+
+	static void dequantizeMtx(float* _mtx, const float* _dequantize)
+	{
+		bx::mtxSRT(_mtx
+			, _dequantize[3]
+			, _dequantize[3]
+			, _dequantize[3]
+			, 0.0f
+			, 0.0f
+			, 0.0f
+			, _dequantize[0]
+			, _dequantize[1]
+			, _dequantize[2]
+			);
+	}
+
+	void drawAllModels(bgfx::ViewId _pass, bgfx::ProgramHandle _program, bgfx::ProgramHandle _instancedProgram, uint64_t _state, const Uniforms & _uniforms)
+	{
+		if (useCulling() )
+		{
+			// One indirect draw per group of each mesh, instance count written
+			// by cull pass
+			for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
+			{
+				if (0 == m_meshInstanceCount[ii])
+				{
+					continue;
+				}
+
+				const Mesh* mesh = m_meshes[ii];
+				for (uint32_t group = 0; group < uint32_t(mesh->m_groups.size() ); ++group)
+				{
+					bgfx::setIndexBuffer(mesh->m_groups[group].m_ibh);
+					bgfx::setVertexBuffer(0, mesh->m_groups[group].m_vbh);
+					bgfx::setInstanceDataBuffer(m_culledInstances, m_meshInstanceStart[ii], m_meshInstanceCount[ii]);
+					bgfx::setTexture(0, s_albedo, m_groundTexture);
+					bgfx::setTexture(1, s_normal, m_normalTexture);
+					bgfx::setState(_state);
+					_uniforms.submit();
+
+					bgfx::submit(_pass, _instancedProgram, m_indirect, uint16_t(m_meshFirstDraw[ii] + group) );
+				}
+			}
+		}
+		else if (m_useInstancing)
+		{
+			// One draw per mesh, transform comes from instance data
+			float mtx[16];
+			bx::mtxIdentity(mtx);
+
+			for (uint32_t ii = 0; ii < BX_COUNTOF(s_meshPaths); ++ii)
+			{
+				if (0 == m_meshInstanceCount[ii]
+				||  NULL == m_meshes[ii])
+				{
+					continue;
+				}
+
+				bgfx::setInstanceDataBuffer(m_instanceBuffer, m_meshInstanceStart[ii], m_meshInstanceCount[ii]);
+				bgfx::setTexture(0, s_albedo, m_groundTexture);
+				bgfx::setTexture(1, s_normal, m_normalTexture);
+				_uniforms.submit();
+
+				meshSubmit(m_meshes[ii], _pass, _instancedProgram, mtx, _state);
+			}
+		}
+		else if (1 < m_submitThreads)
+		{
+			// One contiguous range of models per thread
+			SubmitModelsJob job;
+			job.m_app = this;
+			job.m_pass = _pass;
+			job.m_program = _program;
+			job.m_state = _state;
+			job.m_uniforms = &_uniforms;
+			job.m_numJobs = uint32_t(m_submitThreads);
+			m_jobs.run(submitModelsJob, &job, job.m_numJobs, job.m_numJobs);
+		}
+		else
+		{
+			for (int32_t ii = 0; ii < m_modelCount; ++ii)
+			{
+				const Model& model = m_models[m_modelsSorted ? m_modelOrder[ii] : uint32_t(ii)];
+				if (NULL == m_meshes[model.mesh])
+				{
+					continue;
+				}
+
+				// Set up transform matrix for each model
+				float mtx[16];
+				modelMtx(mtx, model.mesh, model.position);
+
+				// Submit mesh to gbuffer
+				bgfx::setTexture(0, s_albedo, m_groundTexture);
+				bgfx::setTexture(1, s_normal, m_normalTexture);
+				_uniforms.submit();
+
+				meshSubmit(m_meshes[model.mesh], _pass, _program, mtx, _state);
+			}
+		}
+
+		// Draw ground last, it is behind models standing on it
+		if (NULL == m_ground)
+		{
+			return;
+		}
+
+		float mtxScale[16];
+		const float scale = 10.0f;
+		bx::mtxScale(mtxScale, m_groundScale, scale, m_groundScale);
+
+		float mtxTranslate[16];
+		bx::mtxTranslate(mtxTranslate
+			, 0.0f
+			, -10.0f
+			, 0.0f
+			);
+
+		float mtxGround[16];
+		bx::mtxMul(mtxGround, mtxScale, mtxTranslate);
+
+		float mtxDequantize[16];
+		dequantizeMtx(mtxDequantize, m_groundDequantize);
+
+		float mtx[16];
+		bx::mtxMul(mtx, mtxDequantize, mtxGround);
+		bgfx::setTexture(0, s_albedo, m_groundTexture);
+		bgfx::setTexture(1, s_normal, m_normalTexture);
+		_uniforms.submit();
+
+		meshSubmit(m_ground, _pass, _program, mtx, _state);
+	}
+
+	// hi-z reads linear depth, and compute path writes shadows, as images
+	uint64_t computeTargetFlags() const
+	{
+		return m_computeSupported
+			? s_pointSampleFlags | BGFX_TEXTURE_COMPUTE_WRITE
+			: s_pointSampleFlags
+			;
+	}
+
+	// Declare this frame's passes in submission order, with the targets they
+	// read and write. Targets created here are transient and taken from the
+	// graph's pool, gbuffer, hi-z and history are owned by the app
+	void buildGraph()
+	{
+		GraphPasses& passes = m_graphPasses;
+		GraphTargets& targets = m_graphTargets;
+		bx::memSet(&passes, 0xff, sizeof(passes) );
+		bx::memSet(&targets, 0xff, sizeof(targets) );
+		m_graph.reset();
+
+		const uint16_t width = uint16_t(m_size[0]);
+		const uint16_t height = uint16_t(m_size[1]);
+		const uint16_t traceWidth = uint16_t(m_traceSize[0]);
+		const uint16_t traceHeight = uint16_t(m_traceSize[1]);
+		const uint64_t computeFlags = computeTargetFlags();
+		const bgfx::TextureHandle invalidTexture = BGFX_INVALID_HANDLE;
+		const bgfx::FrameBufferHandle invalidBuffer = BGFX_INVALID_HANDLE;
+
+		targets.m_gbuffer = m_graph.importTarget("gbuffer", invalidTexture, m_gbuffer);
+		targets.m_hiz = m_graph.importTarget("hi-z", m_hiz, invalidBuffer);
+		targets.m_history = m_graph.importTarget("history", m_history[m_historyIdx].m_shadows, m_history[m_historyIdx].m_buffer);
+		targets.m_prevHistory = m_graph.importTarget("previous history", m_history[1 - m_historyIdx].m_shadows, m_history[1 - m_historyIdx].m_buffer);
+		targets.m_backbuffer = m_graph.importTarget("backbuffer", invalidTexture, invalidBuffer);
+
+		if (useCulling() )
+		{
+			// hi-z max of previous frame
+			targets.m_indirect = m_graph.importTarget("indirect draws", invalidTexture, invalidBuffer);
+			passes.m_cull = m_graph.addPass("cull");
+			m_graph.read(passes.m_cull, targets.m_hiz);
+			m_graph.write(passes.m_cull, targets.m_indirect);
+		}
+
+		if (m_useDepthPrepass)
+		{
+			passes.m_depthPrepass = m_graph.addPass("depth prepass");
+			m_graph.read(passes.m_depthPrepass, targets.m_indirect);
+			m_graph.write(passes.m_depthPrepass, targets.m_gbuffer);
+		}
+
+		passes.m_gbuffer = m_graph.addPass("gbuffer");
+		m_graph.read(passes.m_gbuffer, targets.m_indirect);
+		if (m_useDepthPrepass)
+		{
+			// depth test against prepass
+			m_graph.read(passes.m_gbuffer, targets.m_gbuffer);
+		}
+		m_graph.write(passes.m_gbuffer, targets.m_gbuffer);
+
+		if (m_displayOverdraw
+		&&  m_readbackSupported
+		&&  UINT32_MAX == m_overdrawFrame)
+		{
+			passes.m_overdrawReadback = m_graph.addPass("overdraw readback", true);
+			m_graph.read(passes.m_overdrawReadback, targets.m_gbuffer);
+		}
+
+		targets.m_depth = targets.m_gbuffer;
+		if (DepthSource::LinearPass == m_activeDepthSource)
+		{
+			targets.m_depth = m_graph.createTarget("linear depth", { width, height, bgfx::TextureFormat::R16F, computeFlags });
+			passes.m_linearDepth = m_graph.addPass("linear depth");
+			m_graph.read(passes.m_linearDepth, targets.m_gbuffer);
+			m_graph.write(passes.m_linearDepth, targets.m_depth);
+		}
+
+		// occlusion culling reads pyramid next frame, outside of this graph
+		if (useHiZ() || useOcclusionCulling() )
+		{
+			passes.m_hiz = m_graph.addPass("hi-z", useOcclusionCulling() );
+			m_graph.read(passes.m_hiz, targets.m_depth);
+			m_graph.write(passes.m_hiz, targets.m_hiz);
+		}
+
+		// dynamic resolution alone traces at full resolution, where linear
+		// depth from its own pass can be read as is
+		const bool reducedResolution = useUpsample();
+		if (reducedResolution)
+		{
+			targets.m_shadowsLowRes = m_graph.createTarget("shadows low res", { traceWidth, traceHeight, bgfx::TextureFormat::RGBA8, computeFlags });
+			if (1 < m_traceDownscale
+			||  DepthSource::LinearPass != m_activeDepthSource)
+			{
+				targets.m_linearDepthLowRes = m_graph.createTarget("linear depth low res", { traceWidth, traceHeight, bgfx::TextureFormat::R16F, s_pointSampleFlags });
+				passes.m_downsampleDepth = m_graph.addPass("downsample depth");
+				m_graph.read(passes.m_downsampleDepth, targets.m_depth);
+				m_graph.write(passes.m_downsampleDepth, targets.m_linearDepthLowRes);
+			}
+			else
+			{
+				targets.m_linearDepthLowRes = targets.m_depth;
+			}
+		}
+
+		targets.m_shadows = m_graph.createTarget("shadows", { width, height, bgfx::TextureFormat::RGBA8, computeFlags });
+		passes.m_shadows = m_graph.addPass("screen space shadows");
+		m_graph.read(passes.m_shadows, reducedResolution ? targets.m_linearDepthLowRes : targets.m_depth);
+		if (useHiZ() )
+		{
+			m_graph.read(passes.m_shadows, targets.m_hiz);
+		}
+		m_graph.write(passes.m_shadows, reducedResolution ? targets.m_shadowsLowRes : targets.m_shadows);
+
+		if (reducedResolution)
+		{
+			passes.m_upsampleShadows = m_graph.addPass("upsample shadows");
+			m_graph.read(passes.m_upsampleShadows, targets.m_shadowsLowRes);
+			m_graph.read(passes.m_upsampleShadows, targets.m_linearDepthLowRes);
+			m_graph.read(passes.m_upsampleShadows, targets.m_depth);
+			m_graph.read(passes.m_upsampleShadows, targets.m_gbuffer);
+			m_graph.write(passes.m_upsampleShadows, targets.m_shadows);
+		}
+
+		if (m_validationRequested)
+		{
+			targets.m_readbackDepth = m_graph.createTarget("readback depth", { width, height, bgfx::TextureFormat::R32F, s_pointSampleFlags });
+			passes.m_copyDepth = m_graph.addPass("copy depth");
+			m_graph.read(passes.m_copyDepth, targets.m_depth);
+			m_graph.write(passes.m_copyDepth, targets.m_readbackDepth);
+
+			passes.m_readback = m_graph.addPass("readback", true);
+			m_graph.read(passes.m_readback, targets.m_readbackDepth);
+			m_graph.read(passes.m_readback, targets.m_shadows);
+		}
+
+		targets.m_resolvedShadows = targets.m_shadows;
+		if (m_useDenoise)
+		{
+			// same description as shadows, so denoised shadows can take their place
+			targets.m_shadowsBlur = m_graph.createTarget("shadows blur", { width, height, bgfx::TextureFormat::RGBA8, computeFlags });
+			targets.m_shadowsDenoised = m_graph.createTarget("shadows denoised", { width, height, bgfx::TextureFormat::RGBA8, computeFlags });
+
+			passes.m_blurX = m_graph.addPass("blur x");
+			m_graph.read(passes.m_blurX, targets.m_shadows);
+			m_graph.read(passes.m_blurX, targets.m_depth);
+			m_graph.write(passes.m_blurX, targets.m_shadowsBlur);
+
+			passes.m_blurY = m_graph.addPass("blur y");
+			m_graph.read(passes.m_blurY, targets.m_shadowsBlur);
+			m_graph.read(passes.m_blurY, targets.m_depth);
+			m_graph.write(passes.m_blurY, targets.m_shadowsDenoised);
+
+			targets.m_resolvedShadows = targets.m_shadowsDenoised;
+		}
+
+		if (m_useTemporal)
+		{
+			passes.m_temporal = m_graph.addPass("temporal");
+			m_graph.read(passes.m_temporal, targets.m_resolvedShadows);
+			m_graph.read(passes.m_temporal, targets.m_depth);
+			m_graph.read(passes.m_temporal, targets.m_prevHistory);
+			m_graph.write(passes.m_temporal, targets.m_history);
+		}
+
+		passes.m_combine = m_graph.addPass("combine", true);
+		m_graph.read(passes.m_combine, targets.m_gbuffer);
+		m_graph.read(passes.m_combine, targets.m_depth);
+		m_graph.read(passes.m_combine, m_useTemporal ? targets.m_history : targets.m_resolvedShadows);
+		m_graph.write(passes.m_combine, targets.m_backbuffer);
+
+		m_graph.compile(0, m_currFrame, GRAPH_POOL_MAX_AGE);
+	}
+
+	void createFramebuffers()
+	{
+		m_size[0] = m_width;
+		m_size[1] = m_height;
+
+		// hi-z reads linear depth as an image
+		const uint64_t linearDepthFlags = computeTargetFlags();
+
+		m_activeDepthSource = m_depthSource;
+		m_activeGbufferLayout = m_compactGbufferSupported ? m_gbufferLayout : GbufferLayout::Default;
+		m_activeReversedZ = m_reversedZSupported && m_useReversedZ;
+
+		// reversed z needs float depth, with fixed point it only moves precision around
+		const bgfx::TextureFormat::Enum depthFormat = m_activeReversedZ
+			? bgfx::TextureFormat::D32F
+			: bgfx::TextureFormat::D24
+			;
+		m_gbufferState = 0
+			| BGFX_STATE_WRITE_RGB
+			| BGFX_STATE_WRITE_A
+			| BGFX_STATE_WRITE_Z
+			| (m_activeReversedZ ? BGFX_STATE_DEPTH_TEST_GREATER : BGFX_STATE_DEPTH_TEST_LESS)
+			| BGFX_STATE_CULL_CW
+			| BGFX_STATE_MSAA
+			;
+
+		// compact layout keeps roughness in color alpha, normal target is half size
+		const bgfx::TextureFormat::Enum normalFormat = GbufferLayout::Compact == m_activeGbufferLayout
+			? bgfx::TextureFormat::RG8
+			: bgfx::TextureFormat::BGRA8
+			;
+
+		m_gbufferTex[GBUFFER_RT_COLOR]    = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::BGRA8, s_pointSampleFlags);
+		m_gbufferTex[GBUFFER_RT_NORMAL]   = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, normalFormat, s_pointSampleFlags);
+		m_gbufferTex[GBUFFER_RT_LINEAR_DEPTH] = BGFX_INVALID_HANDLE;
+		if (DepthSource::GbufferTarget == m_activeDepthSource)
+		{
+			m_gbufferTex[GBUFFER_RT_LINEAR_DEPTH] = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::R16F, linearDepthFlags);
+		}
+		m_gbufferTex[GBUFFER_RT_DEPTH]    = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, depthFormat, s_pointSampleFlags);
+
+		// linear depth target is only attached when gbuffer writes it
+		bgfx::TextureHandle attachments[GBUFFER_RENDER_TARGETS];
+		uint8_t numAttachments = 0;
+		for (uint32_t ii = 0; ii < GBUFFER_RENDER_TARGETS; ++ii)
+		{
+			if (bgfx::isValid(m_gbufferTex[ii]) )
+			{
+				attachments[numAttachments++] = m_gbufferTex[ii];
+			}
+		}
+		m_gbuffer = bgfx::createFrameBuffer(numAttachments, attachments, true);
+
+		// later passes read depth from here, hardware depth must be linearized.
+		// Linear depth pass writes a transient target from render graph
+		m_depthIsHardware = false;
+		m_depthTexture = BGFX_INVALID_HANDLE;
+		if (DepthSource::GbufferTarget == m_activeDepthSource)
+		{
+			m_depthTexture = m_gbufferTex[GBUFFER_RT_LINEAR_DEPTH];
+		}
+		else if (DepthSource::HardwareInline == m_activeDepthSource)
+		{
+			m_depthTexture = m_gbufferTex[GBUFFER_RT_DEPTH];
+			m_depthIsHardware = true;
+		}
+
+		// hi-z pyramid starts at half resolution, rounded up so no pixel is dropped
+		m_hizSize[0] = (m_size[0] + 1) / 2;
+		m_hizSize[1] = (m_size[1] + 1) / 2;
+		m_hizLevels = 1 + uint8_t(bx::log2(float(bx::max(m_hizSize[0], m_hizSize[1]) ) ) );
+
+		// readback copies of full resolution depth and shadows, and
+		// gbuffer color holding overdraw
+		m_readbackDepth = BGFX_INVALID_HANDLE;
+		m_readbackShadows = BGFX_INVALID_HANDLE;
+		m_readbackOverdraw = BGFX_INVALID_HANDLE;
+		if (m_readbackSupported)
+		{
+			const uint64_t readbackFlags = BGFX_TEXTURE_BLIT_DST | BGFX_TEXTURE_READ_BACK;
+			m_readbackDepth = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::R32F, readbackFlags);
+			m_readbackShadows = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::RGBA8, readbackFlags);
+			m_readbackOverdraw = bgfx::createTexture2D(uint16_t(m_size[0]), uint16_t(m_size[1]), false, 1, bgfx::TextureFormat::BGRA8, readbackFlags);
+		}
+		m_readbackFrame = UINT32_MAX;
+
+		m_hiz = BGFX_INVALID_HANDLE;
+		if (m_computeSupported)
+		{
+			const uint64_t hizFlags = 0
+				| BGFX_TEXTURE_COMPUTE_WRITE
+				| BGFX_SAMPLER_U_CLAMP
+				| BGFX_SAMPLER_V_CLAMP
+				| BGFX_SAMPLER_MIN_POINT
+				| BGFX_SAMPLER_MAG_POINT
+				| BGFX_SAMPLER_MIP_POINT
+				;
+			m_hiz = bgfx::createTexture2D(uint16_t(m_hizSize[0]), uint16_t(m_hizSize[1]), true, 1, bgfx::TextureFormat::R16F, hizFlags);
+			m_hizMax = bgfx::createTexture2D(uint16_t(m_hizSize[0]), uint16_t(m_hizSize[1]), true, 1, bgfx::TextureFormat::R16F, hizFlags);
+		}
+		m_havePreviousHiZ = false;
+
+		for (uint32_t ii = 0; ii < BX_COUNTOF(m_history); ++ii)
+		{
+			m_history[ii].init(m_size[0], m_size[1], s_pointSampleFlags);
+		}
+		m_havePrevious = false;
+	}
+
+	// all buffers set to destroy their textures
+	void destroyFramebuffers()
+	{
+		bgfx::destroy(m_gbuffer);
+
+		for (uint32_t ii = 0; ii < BX_COUNTOF(m_history); ++ii)
+		{
+			m_history[ii].destroy();
+		}
+
+		if (bgfx::isValid(m_hiz))
+		{
+			bgfx::destroy(m_hiz);
+			bgfx::destroy(m_hizMax);
+		}
+
+		if (bgfx::isValid(m_readbackDepth) )
+		{
+			bgfx::destroy(m_readbackDepth);
+			bgfx::destroy(m_readbackShadows);
+			bgfx::destroy(m_readbackOverdraw);
+		}
 	}
 
 	void updateUniforms()
 	{
-		m_uniforms.m_displayShadows = m_displayShadows ? 1.0f : 0.0f;
+		m_uniforms.m_displayMode = m_displayOverdraw ? 2.0f : (m_displayShadows ? 1.0f : 0.0f);
 		m_uniforms.m_frameIdx = m_dynamicNoise
 			? float(m_currFrame % 8)
 			: 0.0f;
 		m_uniforms.m_shadowRadius = m_useScreenSpaceRadius ? m_shadowRadiusPixels : m_shadowRadius;
-		m_uniforms.m_shadowSteps = float(m_shadowSteps);
+		m_uniforms.m_shadowSteps = float(dynamicShadowSteps() );
 		m_uniforms.m_useNoiseOffset = m_useNoiseOffset ? 1.0f : 0.0f;
 		m_uniforms.m_contactShadowsMode = float(m_contactShadowsMode);
 		m_uniforms.m_useScreenSpaceRadius = m_useScreenSpaceRadius ? 1.0f : 0.0f;
@@ -738,21 +3946,32 @@ public:
 		mat4Set(m_uniforms.m_worldToView, m_view);
 		mat4Set(m_uniforms.m_viewToProj, m_proj);
 
-		// from assao sample, cs_assao_prepare_depths.sc
-		{
-			// float depthLinearizeMul = ( clipFar * clipNear ) / ( clipFar - clipNear );
-			// float depthLinearizeAdd = clipFar / ( clipFar - clipNear );
-			// correct the handedness issue. need to make sure this below is correct, but I think it is.
+		vec2Set(m_uniforms.m_shadowsSize, float(m_scaledTraceSize[0]), float(m_scaledTraceSize[1]));
+		vec2Set(m_uniforms.m_screenTexel, 1.0f / float(m_size[0]), 1.0f / float(m_size[1]));
+		m_uniforms.m_traceDownscale = float(m_traceDownscale);
+		m_uniforms.m_useHiZ = useHiZ() ? 1.0f : 0.0f;
+		m_uniforms.m_depthIsHardware = m_depthIsHardware ? 1.0f : 0.0f;
+		m_uniforms.m_hizStepScale = float(m_hizStepScale);
+		m_uniforms.m_hizMaxLevel = float(bx::min(int32_t(m_hizLevels) - 1, HIZ_MAX_LEVEL) );
+		vec2Set(m_uniforms.m_hizSize, float(m_hizSize[0]), float(m_hizSize[1]) );
 
-			float depthLinearizeMul = -m_proj2[3*4+2];
-			float depthLinearizeAdd =  m_proj2[2*4+2];
+		m_uniforms.m_temporalBlend = m_temporalBlend;
+		m_uniforms.m_temporalDepthTolerance = 0.05f;
+		m_uniforms.m_havePrevious = m_havePrevious ? 1.0f : 0.0f;
 
-			if (depthLinearizeMul * depthLinearizeAdd < 0)
-			{
-				depthLinearizeAdd = -depthLinearizeAdd;
-			}
+		// current view space -> world -> previous view -> previous clip
+		{
+			float viewToWorld[16];
+			bx::mtxInverse(viewToWorld, m_view);
+			float worldToPrevClip[16];
+			bx::mtxMul(worldToPrevClip, m_prevView, m_prevProj);
+			bx::mtxMul(m_uniforms.m_viewToPrevClip, viewToWorld, worldToPrevClip);
+		}
 
-			vec2Set(m_uniforms.m_depthUnpackConsts, depthLinearizeMul, depthLinearizeAdd);
+		// from assao sample, cs_assao_prepare_depths.sc
+		{
+			// shared with the cpu reference, which linearizes hardware depth the same way
+			sss::depthUnpackConsts(m_proj2, m_uniforms.m_depthUnpackConsts);
 
 			float tanHalfFOVY = 1.0f / m_proj2[1*4+1];	// = tanf( drawContext.Camera.GetYFOV( ) * 0.5f );
 			float tanHalfFOVX = 1.0F / m_proj2[0];		// = tanHalfFOVY * drawContext.Camera.GetAspect( );
@@ -769,13 +3988,19 @@ public:
 			}
 		}
 
+		m_uniforms.m_lightCount = float(m_lightCount);
+		m_uniforms.m_useAdaptiveSteps = m_useAdaptiveSteps ? 1.0f : 0.0f;
+		m_uniforms.m_useScreenSpaceMarch = m_useScreenSpaceMarch ? 1.0f : 0.0f;
+		m_uniforms.m_useBlueNoise = useBlueNoise() ? 1.0f : 0.0f;
+		m_uniforms.m_useClusteredLighting = useClusteredLighting() ? 1.0f : 0.0f;
+		for (int32_t ii = 0; ii < m_lightCount; ++ii)
 		{
 			float lightPosition[4];
-			bx::memCopy(lightPosition, m_lightModel.position, 3*sizeof(float));
+			bx::memCopy(lightPosition, m_lightModels[ii].position, 3*sizeof(float));
 			lightPosition[3] = 1.0f;
 			float viewSpaceLightPosition[4];
 			bx::vec4MulMtx(viewSpaceLightPosition, lightPosition, m_view);
-			bx::memCopy(m_uniforms.m_lightPosition, viewSpaceLightPosition, 3*sizeof(float));
+			bx::memCopy(m_uniforms.m_lightPosition[ii], viewSpaceLightPosition, 3*sizeof(float));
 		}
 	}
 
@@ -788,11 +4013,32 @@ public:
 	entry::MouseState m_mouseState;
 
 	// Resource handles
-	bgfx::ProgramHandle m_gbufferProgram;
-	bgfx::ProgramHandle m_sphereProgram;
+	bgfx::ProgramHandle m_gbufferProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_sphereProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_gbufferLinearDepthProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_sphereLinearDepthProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_gbufferInstancedProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_gbufferInstancedLinearDepthProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_depthPrepassProgram;
+	bgfx::ProgramHandle m_depthPrepassInstancedProgram;
+	bgfx::ProgramHandle m_overdrawProgram;
+	bgfx::ProgramHandle m_overdrawLinearDepthProgram;
+	bgfx::ProgramHandle m_overdrawInstancedProgram;
+	bgfx::ProgramHandle m_overdrawInstancedLinearDepthProgram;
 	bgfx::ProgramHandle m_linearDepthProgram;
+	bgfx::ProgramHandle m_copyDepthProgram;
 	bgfx::ProgramHandle m_shadowsProgram;
-	bgfx::ProgramHandle m_combineProgram;
+	bgfx::ProgramHandle m_combineProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_shadowsComputeProgram;
+	bgfx::ProgramHandle m_downsampleDepthProgram;
+	bgfx::ProgramHandle m_upsampleShadowsProgram[GbufferLayout::Count];
+	bgfx::ProgramHandle m_hizProgram;
+	bgfx::ProgramHandle m_cullModelsProgram;
+	bgfx::ProgramHandle m_cullDrawsProgram;
+	bgfx::ProgramHandle m_temporalProgram;
+	bgfx::ProgramHandle m_blurShadowsProgram;
+	bgfx::ProgramHandle m_shadowsVariants[SHADOWS_VARIANT_MODES][SHADOWS_VARIANT_RADIUS][BX_COUNTOF(s_shadowStepBuckets)];
+	bgfx::ProgramHandle m_shadowsComputeVariants[SHADOWS_VARIANT_MODES][SHADOWS_VARIANT_RADIUS][BX_COUNTOF(s_shadowStepBuckets)];
 
 	// Shader uniforms
 	Uniforms m_uniforms;
@@ -803,12 +4049,45 @@ public:
 	bgfx::UniformHandle s_normal;
 	bgfx::UniformHandle s_depth;
 	bgfx::UniformHandle s_shadows;
+	bgfx::UniformHandle s_depthLowRes;
+	bgfx::UniformHandle s_hiz;
+	bgfx::UniformHandle s_hizMax;
+	bgfx::UniformHandle s_shadowsHistory;
+	bgfx::UniformHandle s_depthHistory;
+	bgfx::UniformHandle s_blueNoise;
+	bgfx::UniformHandle s_clusters;
+	bgfx::UniformHandle s_clusterLights;
+	bgfx::UniformHandle s_clusterIndices;
 
 	bgfx::FrameBufferHandle m_gbuffer;
 	bgfx::TextureHandle m_gbufferTex[GBUFFER_RENDER_TARGETS];
 
-	RenderTarget m_linearDepth;
-	RenderTarget m_shadows;
+	bgfx::TextureHandle m_depthTexture;
+	bool m_depthIsHardware = false;
+	int32_t m_activeDepthSource = DepthSource::LinearPass;
+	int32_t m_activeGbufferLayout = GbufferLayout::Default;
+	bool m_compactGbufferSupported = false;
+	bool m_activeReversedZ = false;
+	bool m_reversedZSupported = false;
+	uint64_t m_gbufferState = BGFX_STATE_DEFAULT;
+
+	sss::RenderGraph m_graph;
+	GraphPasses m_graphPasses;
+	GraphTargets m_graphTargets;
+	int32_t m_pendingSize[2] = { 0, 0 };
+	uint32_t m_pendingSizeFrames = 0;
+
+	bgfx::TextureHandle m_hiz;
+	bgfx::TextureHandle m_hizMax;
+	bool m_havePreviousHiZ = false;
+	int32_t m_hizSize[2];
+	uint8_t m_hizLevels = 1;
+
+	bgfx::TextureHandle m_readbackDepth;
+	bgfx::TextureHandle m_readbackShadows;
+
+	HistoryTarget m_history[2];
+	uint32_t m_historyIdx = 0;
 
 	struct Model
 	{
@@ -816,12 +4095,71 @@ public:
 		float position[3];
 	};
 
-	Model m_lightModel;
-	Model m_models[MODEL_COUNT];
+	Model m_lightModels[MAX_LIGHTS];
+	Model* m_models; // MAX_MODEL_COUNT, sorted by mesh
+
+	// Submission order of models front to back, when not instanced. Sort
+	// keys and temporaries share allocation of m_modelOrder
+	bool m_sortModels = true;
+	bool m_modelsSorted = false;
+	uint32_t* m_modelOrder = NULL;
+	uint32_t* m_sortTempOrder = NULL;
+	uint32_t* m_sortKeys = NULL;
+	uint32_t* m_sortTempKeys = NULL;
+	int64_t m_modelSortTime = 0;
+
+	// Depth prepass, and display of fragments shaded by gbuffer read back to
+	// cpu once m_overdrawFrame is reached
+	bool m_useDepthPrepass = false;
+	bool m_blendIndependentSupported = false;
+	bgfx::TextureHandle m_readbackOverdraw;
+	uint8_t* m_overdrawData = NULL;
+	uint32_t m_overdrawPixels = 0;
+	uint32_t m_overdrawFrame = UINT32_MAX;
+	float m_overdrawPerPixel = 0.0f;
+	float m_overdrawPerCovered = 0.0f;
+	int32_t m_modelCount = MODEL_COUNT;
+	uint32_t m_meshInstanceStart[BX_COUNTOF(s_meshPaths)];
+	uint32_t m_meshInstanceCount[BX_COUNTOF(s_meshPaths)];
+	bgfx::VertexBufferHandle m_instanceBuffer;
+	float m_groundScale = 10.0f;
 	Mesh* m_meshes[BX_COUNTOF(s_meshPaths)];
 	Mesh* m_ground;
+
+	// Baked meshes and their position dequantization, center in xyz and
+	// extent in w. Identity for source meshes
+	bool m_useBakedMeshes = false;
+	bool m_bakeMeshes = false;
+	float m_meshDequantize[BX_COUNTOF(s_meshPaths)][4];
+	float m_groundDequantize[4];
 	bgfx::TextureHandle m_groundTexture;
 	bgfx::TextureHandle m_normalTexture;
+	bgfx::TextureHandle m_blueNoiseTexture;
+	bgfx::TextureHandle m_loadedBlueNoiseTexture;
+	uint8_t m_blueNoise[BLUE_NOISE_SIZE * BLUE_NOISE_SIZE]; // written by loader thread until m_blueNoiseLoaded
+	bool m_blueNoiseLoaded = false;
+
+	// Clustered lighting. Cluster offsets and counts, light indices and
+	// light rows share allocation of m_clusterData
+	struct PointLight
+	{
+		float position[3];
+		float radius;
+		float color[3];
+	};
+
+	PointLight m_pointLights[MAX_POINT_LIGHTS];
+	bool m_clusteredSupported = false;
+	bool m_useClusteredLighting = false;
+	int32_t m_pointLightCount = 64;
+	float* m_clusterData = NULL;
+	float* m_clusterIndices = NULL;
+	float* m_clusterLightData = NULL;
+	bgfx::TextureHandle m_clusterTexture;
+	bgfx::TextureHandle m_clusterLightTexture;
+	bgfx::TextureHandle m_clusterIndexTexture;
+	uint32_t m_clusterIndexCount = 0;
+	int64_t m_clusterTime = 0;
 
 	uint32_t m_currFrame;
 	float m_lightRotation = 0.0f;
@@ -829,22 +4167,135 @@ public:
 	float m_fovY = 60.0f;
 	bool m_recreateFrameBuffers = false;
 	bool m_havePrevious = false;
+	bool m_computeSupported = false;
+	bool m_readbackSupported = false;
+	bool m_instancingSupported = false;
+	bool m_useInstancing = false;
+
+	// Gpu culling of instanced models, visible instances of each mesh are
+	// packed into its range of m_culledInstances
+	bool m_cullingSupported = false;
+	bool m_useCulling = false;
+	bool m_useOcclusionCulling = false;
+	bgfx::DynamicVertexBufferHandle m_culledInstances;
+	bgfx::DynamicIndexBufferHandle m_meshCounts;
+	bgfx::IndexBufferHandle m_drawInfo;
+	bgfx::IndirectBufferHandle m_indirect;
+	uint32_t m_meshFirstDraw[CULL_MESH_COUNT];
+	uint32_t m_cullDrawCount = 0;
+	float m_meshBounds[CULL_MESH_COUNT][4];
+
+	// Assets loaded in background, results are written by loader thread and
+	// taken by main thread once their job has finished
+	sss::AssetLoader m_loader;
+	Mesh* m_loadedMeshes[BX_COUNTOF(s_meshPaths)];
+	Mesh* m_loadedGround;
+	float m_loadedMeshDequantize[BX_COUNTOF(s_meshPaths)][4];
+	float m_loadedGroundDequantize[4];
+	bgfx::TextureHandle m_loadedGroundTexture;
+	bgfx::TextureHandle m_loadedNormalTexture;
+	uint32_t m_numLoaded = 0;
+	bool m_assetsLoaded = false;
+	int64_t m_initTime = 0;
+	int64_t m_firstFrameTime = 0;
+
+	// Multithreaded submission of models when not instanced
+	sss::JobPool m_jobs;
+	uint32_t m_maxSubmitThreads = 1;
+	int32_t m_submitThreads = 1;
+	int64_t m_modelSubmitTime = 0;
+	int32_t m_scalingStep = -1;
+	int32_t m_scalingFrame = 0;
+	int64_t m_scalingTime = 0;
+	int32_t m_scalingPrevThreads = 1;
+	uint32_t m_scalingCount = 0;
+	int32_t m_scalingThreads[SUBMIT_MAX_THREADS];
+	float m_scalingMs[SUBMIT_MAX_THREADS];
 
 	float m_view[16];
 	float m_proj[16];
 	float m_proj2[16];
+	float m_prevView[16];
+	float m_prevProj[16];
 	int32_t m_size[2];
+	int32_t m_traceSize[2];
+	int32_t m_scaledTraceSize[2];
+	float m_shadowsUvScale[2];
+	int32_t m_traceDownscale = 1;
+	bgfx::ViewId m_shadowsView = 0;
+
+	// Uber-shader vs specialised timings, index 0 is uber-shader
+	uint32_t m_compareFrame = 0;
+	double m_compareTime[2] = { 0.0, 0.0 };
+	uint32_t m_compareSamples[2] = { 0, 0 };
 
 	// UI parameters
 	bool m_displayShadows = false;
+	bool m_displayOverdraw = false;
 	bool m_useNoiseOffset = true;
+	bool m_useAdaptiveSteps = false;
+	bool m_useScreenSpaceMarch = false;
+	bool m_useBlueNoise = false;
+	bool m_useDenoise = false;
 	bool m_dynamicNoise = true;
 	float m_shadowRadius = 0.25f;
 	float m_shadowRadiusPixels = 25.0f;
 	int32_t m_shadowSteps = 8;
 	bool m_moveLight = true;
+	int32_t m_lightCount = 1;
 	int32_t m_contactShadowsMode = 0;
 	bool m_useScreenSpaceRadius = false;
+	bool m_useComputeShadows = false;
+	int32_t m_traceResolution = 0;
+	bool m_useHiZ = false;
+	int32_t m_hizStepScale = 4;
+	bool m_useTemporal = false;
+	float m_temporalBlend = 0.1f;
+	bool m_useSpecialisedShadows = false;
+	bool m_showProfiler = false;
+
+	// Profiler
+	ProfilerView m_profilerViews[BX_COUNTOF(s_profilerViews)];
+	uint32_t m_profilerDraws = 0;
+	uint32_t m_profilerComputes = 0;
+	uint32_t m_uniformSubmits = 0;
+	uint32_t m_uniformBytes = 0;
+
+	// Validation against cpu reference, readback is done when frame reaches
+	// m_readbackFrame
+	bool m_validationRequested = false;
+	bool m_validationDone = false;
+	uint32_t m_readbackFrame = UINT32_MAX;
+	uint32_t m_validationPixels = 0;
+	uint8_t* m_readbackShadowsData = NULL;
+	float* m_validationDepth = NULL;
+	float* m_validationShadows = NULL;
+	sss::ReferenceParams m_validationParams;
+	float m_validationTime = 0.0f;
+	float m_validationMeanError[MAX_LIGHTS];
+	float m_validationMaxError[MAX_LIGHTS];
+	float m_validationMismatch[MAX_LIGHTS];
+
+	// Benchmark, timings are sums over measured frames of current configuration
+	bool m_benchmark = false;
+	uint32_t m_benchmarkFrames = BENCHMARK_FRAMES;
+	uint32_t m_benchmarkConfig = 0;
+	uint32_t m_benchmarkFrame = 0;
+	int64_t m_submitTime = 0;
+	bx::FileWriter m_benchmarkWriter;
+	double m_benchmarkFrameCpu = 0.0;
+	double m_benchmarkSubmitCpu = 0.0;
+	double m_benchmarkViewGpu[BX_COUNTOF(s_benchmarkViews)];
+	double m_benchmarkViewCpu[BX_COUNTOF(s_benchmarkViews)];
+	int32_t m_depthSource = DepthSource::LinearPass;
+	int32_t m_gbufferLayout = GbufferLayout::Default;
+	bool m_useReversedZ = false;
+	bool m_useDynamicResolution = false;
+	bool m_useDynamicSteps = false;
+	float m_shadowsBudgetMs = 1.0f;
+	float m_dynamicScale = 1.0f;
+	float m_dynamicStepScale = 1.0f;
+	bool m_compareShaders = false;
 };
 
 } // namespace
@@ -0,0 +1,473 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SCREEN_SPACE_SHADOWS_SH
+#define SCREEN_SPACE_SHADOWS_SH
+
+// Shared by the fragment and compute shadow passes. Includer must define
+// SSS_SAMPLE_DEPTH(_coord) returning linear depth at the given texture
+// coordinate, so each pass can choose where the depth comes from,
+// SSS_SAMPLE_HIZ(_texel, _levelSize, _level) returning min linear depth of a
+// pyramid texel,
+// and SSS_SAMPLE_BLUE_NOISE(_fragCoord) returning tiled blue noise.
+
+#define DEPTH_EPSILON	1e-4
+
+// Screen space march pulls ray end in front of this view depth before
+// projecting it
+#define MARCH_NEAR_Z	1e-3
+
+// Must match BLUE_NOISE_SIZE in screen_space_shadows.cpp
+#define BLUE_NOISE_SIZE	64.0
+
+// Specialised variants built by the makefile define these, so the linear
+// march has a constant trip count and unused accumulators are dropped. The
+// uber-shader reads every option from uniforms instead.
+#ifdef SSS_SHADOW_STEPS
+#	define SHADOW_STEPS				float(SSS_SHADOW_STEPS)
+#else
+#	define SHADOW_STEPS				u_shadowSteps
+#endif // SSS_SHADOW_STEPS
+
+#ifdef SSS_CONTACT_SHADOWS_MODE
+#	define CONTACT_SHADOWS_MODE		float(SSS_CONTACT_SHADOWS_MODE)
+#else
+#	define CONTACT_SHADOWS_MODE		u_contactShadowsMode
+#endif // SSS_CONTACT_SHADOWS_MODE
+
+#ifdef SSS_SCREEN_SPACE_RADIUS
+#	define USE_SCREEN_SPACE_RADIUS	float(SSS_SCREEN_SPACE_RADIUS)
+#else
+#	define USE_SCREEN_SPACE_RADIUS	u_useScreenSpaceRadius
+#endif // SSS_SCREEN_SPACE_RADIUS
+
+// from assao sample, cs_assao_prepare_depths.sc
+vec3 NDCToViewspace( vec2 pos, float viewspaceDepth )
+{
+	vec3 ret;
+
+	ret.xy = (u_ndcToViewMul * pos.xy + u_ndcToViewAdd) * viewspaceDepth;
+
+	ret.z = viewspaceDepth;
+
+	return ret;
+}
+
+float ShadertoyNoise (vec2 uv) {
+	return fract(sin(dot(uv.xy, vec2(12.9898,78.233))) * 43758.5453123);
+}
+
+// Blue noise spreads offsets evenly over neighbouring pixels, so a small
+// blur removes most of the banding. Each frame adds the golden ratio, so a
+// pixel also gets well spread offsets over time.
+float JitterNoise (vec2 fragCoord) {
+	if (0.0 < u_useBlueNoise)
+	{
+		return fract(SSS_SAMPLE_BLUE_NOISE(fragCoord) + 0.61803398875 * u_frameIdx);
+	}
+
+	return ShadertoyNoise(fragCoord + vec2(314.0, 159.0)*u_frameIdx);
+}
+
+vec2 ViewSpaceToTexCoord(vec3 viewSpacePosition, mat4 viewToProj)
+{
+	vec3 psPosition = instMul(viewToProj, vec4(viewSpacePosition, 1.0)).xyw;
+	psPosition.xy *= (1.0/psPosition.z);
+
+	vec2 texCoord = psPosition.xy * 0.5 + 0.5;
+	texCoord.y = 1.0 - texCoord.y;
+	return texCoord;
+}
+
+// compare one sample along the ray against the depth buffer, and accumulate
+// what the different contact shadow modes need
+void AccumulateOcclusion(
+	  vec3 samplePosition
+	, float sampleDepth
+	, float stepIndex
+	, float radius
+	, float steppedDistanceToLight
+	, inout float occluded
+	, inout float softOccluded
+	, inout float firstHit
+	, inout float averageDistanceToBlocker
+	)
+{
+	float delta = (samplePosition.z - sampleDepth);
+	if (DEPTH_EPSILON < delta && delta < radius)
+	{
+		firstHit = min(firstHit, stepIndex);
+		// for hard, soft occlusion
+		occluded += 1.0;
+		// for very soft occlusion
+		softOccluded += saturate(radius - delta);
+
+		// update average distance for pcsssss
+		averageDistanceToBlocker += steppedDistanceToLight;
+	}
+}
+
+// Hi-Z traversal. Try to skip a span of 2^level steps at once, by checking
+// that the ray over that span is in front of the minimum depth of all pixels
+// it covers. Otherwise refine to smaller spans, until single steps are tested
+// the same way as the linear march.
+#define HIZ_MAX_SPAN_LEVEL		5
+
+float MinDepthUnderSpan(vec2 coordA, vec2 coordB)
+{
+	// pick level where a pyramid texel covers whole span, then a 2x2 footprint
+	// at the span's bounding box corners covers every pixel it crosses.
+	// level 0 of the pyramid already covers 2x2 screen pixels.
+	vec2 pixelA = coordA / u_screenTexel;
+	vec2 pixelB = coordB / u_screenTexel;
+	vec2 extent = abs(pixelB - pixelA);
+	float level = max(ceil(log2(max(max(extent.x, extent.y), 1.0))) - 1.0, 0.0);
+	if (u_hizMaxLevel < level)
+	{
+		// span too long, cannot prove anything
+		return -1.0;
+	}
+
+	// map pixels to texels the way cs_sss_cull_models.sc does, last texel of
+	// a level also covers the odd remainder cs_sss_hiz_downsample folds into
+	// it. Dividing by a power of two and flooring is the same as a shift.
+	vec2 hizSize = u_hizSize;
+	vec2 levelScale = vec2_splat(exp2(level));
+	vec2 levelSize = max(floor(hizSize / levelScale), vec2_splat(1.0));
+	vec2 texelMin = min(floor(max(min(pixelA, pixelB), 0.0) * 0.5), hizSize - 1.0);
+	vec2 texelMax = min(floor(max(max(pixelA, pixelB), 0.0) * 0.5), hizSize - 1.0);
+	texelMin = min(floor(texelMin / levelScale), levelSize - 1.0);
+	texelMax = min(floor(texelMax / levelScale), levelSize - 1.0);
+
+	float minDepth = min(
+		  min(SSS_SAMPLE_HIZ(texelMin, levelSize, level), SSS_SAMPLE_HIZ(vec2(texelMax.x, texelMin.y), levelSize, level))
+		, min(SSS_SAMPLE_HIZ(vec2(texelMin.x, texelMax.y), levelSize, level), SSS_SAMPLE_HIZ(texelMax, levelSize, level))
+		);
+	return minDepth;
+}
+
+// Adaptive steps. Project the ray once, and take no more steps than depth
+// texels it crosses, so short rays of distant pixels don't fetch the same
+// texel over and over. First step is pushed out of the shaded pixel's texel.
+void AdaptShadowSteps(vec3 viewSpacePosition, vec3 lightDirection, float radius, mat4 viewToProj, inout float shadowSteps, inout float initialOffset)
+{
+	vec3 rayEnd = viewSpacePosition + lightDirection * radius;
+	if (rayEnd.z <= 0.0)
+	{
+		// end is behind camera, no meaningful length on screen
+		return;
+	}
+
+	vec2 texelA = ViewSpaceToTexCoord(viewSpacePosition, viewToProj) * u_shadowsSize;
+	vec2 texelB = ViewSpaceToTexCoord(rayEnd, viewToProj) * u_shadowsSize;
+	vec2 extent = abs(texelB - texelA);
+	float texels = max(extent.x, extent.y);
+
+	shadowSteps = clamp(ceil(texels), 1.0, shadowSteps);
+
+	float texelsPerStep = texels / shadowSteps;
+	initialOffset = max(initialOffset, min(1.0 / max(texelsPerStep, 1e-4), 1.0));
+}
+
+// march from one view space position towards one light
+float ScreenSpaceShadow(vec3 viewSpacePosition, float radius, float initialOffset, vec3 lightPosition, mat4 viewToProj)
+{
+	// want distance for percentage closer style soft screen space shadows
+	float distanceToLight = length(lightPosition - viewSpacePosition);
+
+	vec3 lightStep = normalize(lightPosition - viewSpacePosition);
+
+	// hi-z skips empty space, so it can afford to take more, smaller steps
+	bool useHiZ = 0.0 < u_useHiZ;
+	float shadowSteps = useHiZ ? (SHADOW_STEPS * u_hizStepScale) : SHADOW_STEPS;
+
+	if (0.0 < u_useAdaptiveSteps)
+	{
+		AdaptShadowSteps(viewSpacePosition, lightStep, radius, viewToProj, shadowSteps, initialOffset);
+	}
+
+	// hard shadows are decided by any hit, stop marching at first one
+	bool stopAtFirstHit = CONTACT_SHADOWS_MODE < 0.5;
+
+	lightStep *= (radius / shadowSteps);
+
+	vec3 samplePosition = viewSpacePosition;
+	samplePosition += initialOffset * lightStep;
+
+	float lengthOfLightStep = (radius/shadowSteps);
+	float steppedDistanceToLight = distanceToLight - (initialOffset*lengthOfLightStep);
+
+	float occluded = 0.0;
+	float softOccluded = 0.0;
+	float firstHit = shadowSteps;
+	float averageDistanceToBlocker = 0.0;
+	if (useHiZ)
+	{
+		vec3 rayStart = samplePosition;
+		float stepIndex = 0.0;
+		float level = 1.0;
+
+		// every iteration either advances at least one step, or refines a
+		// level that an earlier skip or the start raised, so the ray always
+		// finishes within twice its steps plus one
+		int maxIterations = 2 * int(ceil(shadowSteps)) + 1;
+		for (int i = 0; i < maxIterations && stepIndex < shadowSteps; ++i)
+		{
+			if (stopAtFirstHit && 0.0 < occluded)
+			{
+				break;
+			}
+
+			if (0.0 < level)
+			{
+				float span = min(exp2(level), shadowSteps - stepIndex);
+				vec3 spanStart = rayStart + stepIndex * lightStep;
+				vec3 spanEnd = rayStart + (stepIndex + span - 1.0) * lightStep;
+
+				float minDepth = MinDepthUnderSpan(
+					  ViewSpaceToTexCoord(spanStart, viewToProj)
+					, ViewSpaceToTexCoord(spanEnd, viewToProj)
+					);
+
+				// whole span in front of all geometry, no occluder possible
+				if (0.0 <= minDepth && max(spanStart.z, spanEnd.z) - minDepth <= DEPTH_EPSILON)
+				{
+					stepIndex += span;
+					level = min(level + 1.0, float(HIZ_MAX_SPAN_LEVEL));
+				}
+				else
+				{
+					level -= 1.0;
+				}
+			}
+			else
+			{
+				vec3 stepPosition = rayStart + stepIndex * lightStep;
+				float sampleDepth = SSS_SAMPLE_DEPTH(ViewSpaceToTexCoord(stepPosition, viewToProj));
+
+				AccumulateOcclusion(
+					  stepPosition
+					, sampleDepth
+					, stepIndex
+					, radius
+					, steppedDistanceToLight - stepIndex * lengthOfLightStep
+					, occluded
+					, softOccluded
+					, firstHit
+					, averageDistanceToBlocker
+					);
+
+				stepIndex += 1.0;
+				level = 1.0;
+			}
+		}
+	}
+	else if (0.0 < u_useScreenSpaceMarch)
+	{
+		// Screen space march. Project ray once, clip it to near plane and
+		// screen, then step evenly in texture space. 1/w is linear in screen
+		// space and w is view depth, so interpolating it gives perspective
+		// correct depth without projecting every step.
+		vec3 rayStart = samplePosition;
+		vec3 rayEnd = rayStart + shadowSteps * lightStep;
+		float rayFraction = 1.0;
+		if (rayEnd.z < MARCH_NEAR_Z)
+		{
+			rayFraction = saturate((MARCH_NEAR_Z - rayStart.z) / (rayEnd.z - rayStart.z));
+			rayEnd = mix(rayStart, rayEnd, rayFraction);
+		}
+
+		vec3 clipStart = instMul(viewToProj, vec4(rayStart, 1.0)).xyw;
+		vec3 clipEnd = instMul(viewToProj, vec4(rayEnd, 1.0)).xyw;
+		float invWStart = 1.0 / clipStart.z;
+		float invWEnd = 1.0 / clipEnd.z;
+		vec2 coordStart = clipStart.xy * invWStart * vec2(0.5, -0.5) + 0.5;
+		vec2 coordEnd = clipEnd.xy * invWEnd * vec2(0.5, -0.5) + 0.5;
+
+		// start is on screen, stop where ray leaves it
+		vec2 coordDelta = coordEnd - coordStart;
+		vec2 toEdge = abs(step(0.0, coordDelta) - coordStart) / max(abs(coordDelta), vec2_splat(1e-6));
+		float stepFraction = min(min(toEdge.x, toEdge.y), 1.0) / shadowSteps;
+		float viewFractionScale = rayFraction * invWEnd;
+
+		for (int i = 0; i < int(SHADOW_STEPS); ++i)
+		{
+			if (shadowSteps <= float(i)
+			||  (stopAtFirstHit && 0.0 < occluded))
+			{
+				break;
+			}
+
+			float screenFraction = float(i) * stepFraction;
+			vec2 sampleCoord = mix(coordStart, coordEnd, screenFraction);
+			float invW = mix(invWStart, invWEnd, screenFraction);
+
+			float sampleDepth = SSS_SAMPLE_DEPTH(sampleCoord);
+
+			// depth test multiplied through by 1/w of the step, which is
+			// positive, so view depth only needs a divide for hits
+			float scaledDelta = 1.0 - sampleDepth * invW;
+			if (DEPTH_EPSILON * invW < scaledDelta && scaledDelta < radius * invW)
+			{
+				// fraction of whole ray in view space, hits and distances are
+				// measured in the same steps as the other marches
+				float viewFraction = screenFraction * viewFractionScale / invW;
+				vec3 stepPosition = mix(rayStart, rayStart + shadowSteps * lightStep, viewFraction);
+
+				AccumulateOcclusion(
+					  stepPosition
+					, sampleDepth
+					, viewFraction * shadowSteps
+					, radius
+					, steppedDistanceToLight - viewFraction * radius
+					, occluded
+					, softOccluded
+					, firstHit
+					, averageDistanceToBlocker
+					);
+			}
+		}
+	}
+	else
+	{
+		for (int i = 0; i < int(SHADOW_STEPS); ++i, samplePosition += lightStep)
+		{
+			// adaptive steps may end the ray early
+			if (shadowSteps <= float(i)
+			||  (stopAtFirstHit && 0.0 < occluded))
+			{
+				break;
+			}
+
+			vec2 sampleCoord = ViewSpaceToTexCoord(samplePosition, viewToProj);
+
+			float sampleDepth = SSS_SAMPLE_DEPTH(sampleCoord);
+
+			AccumulateOcclusion(
+				  samplePosition
+				, sampleDepth
+				, float(i)
+				, radius
+				, steppedDistanceToLight
+				, occluded
+				, softOccluded
+				, firstHit
+				, averageDistanceToBlocker
+				);
+
+			// track the potential blocker distance, without
+			// re-measuring length of offset between points
+			steppedDistanceToLight -= lengthOfLightStep;
+		}
+	}
+
+	float shadow;
+	if (2.5 < CONTACT_SHADOWS_MODE)
+	{
+		// percentage closer style soft screen space shadows
+
+		// percentage closer equation:
+		// penumbraWidth = (distanceToReceiver - distanceToBlocker) * lightWidth / distanceToBlocker;
+		// where distances are relative to light
+		// uses simliar triangles, assuming blocker, receiver, and light source are parallel
+		// don't have shadow map to search blockers, using linear search of screen space shadow ray march
+
+		// occluded contains number of hits
+		if (0.0 < occluded)
+		{
+			// take average of blockers? might be good if able to use penumbra width
+			// as-is, this introduces light areas where shadows over lap, like vsm artifacts...
+			//averageDistanceToBlocker /= occluded;
+
+			// what if we just use first hit? looks better to me when just visualizing the pw result
+			averageDistanceToBlocker = distanceToLight - (initialOffset + 1.0 + firstHit) * lengthOfLightStep;
+
+			// assume widthOfLight is 1.0 for now
+			float widthOfLight = 1.0;
+			float widthOfPenumbra = (distanceToLight - averageDistanceToBlocker) * widthOfLight / averageDistanceToBlocker;
+
+			// then pcss uses penumbra width to drive filter for percentage closer filtering shadows
+			// don't see a great way to emulate pcf in this context, adding this was maybe not a great way to determine shadows!
+			// eyeballing results, penumbra seems to be roughly between 0 and 0.1 given current scene, so scale that up for result
+			shadow = smoothstep(0.0, 0.1, widthOfPenumbra);
+
+			// pow2 shadows look better
+			shadow = shadow*shadow;
+		}
+		else
+		{
+			shadow = 1.0; // unoccluded
+		}
+	}
+	else if (1.5 < CONTACT_SHADOWS_MODE)
+	{
+		// very soft occlusion, includes distance falloff above
+		shadow = softOccluded * (1.0 - (firstHit / shadowSteps));
+		shadow = 1.0 - saturate(shadow);
+		shadow = shadow*shadow;
+	}
+	else if (0.5 < CONTACT_SHADOWS_MODE)
+	{
+		// soft occlusion
+		shadow = occluded * (1.0 - (firstHit / shadowSteps));
+		shadow = 1.0 - saturate(shadow);
+		shadow = shadow*shadow;
+	}
+	else // == 0
+	{
+		// hard occlusion
+		shadow = 0.0 < occluded ? 0.0 : 1.0;
+	}
+
+	return shadow;
+}
+
+// trace every active light from the same pixel, one light per channel.
+// position, radius and noise are shared, and so are depth samples cached
+// by the includer
+vec4 ScreenSpaceShadows(vec2 texCoord, vec2 fragCoord, float linearDepth)
+{
+	vec3 viewSpacePosition = NDCToViewspace(texCoord, linearDepth);
+
+	// screen space radius not usable directly. convert value given in pixels,
+	// to world units. this is important later when comparing depth in world units
+	float radius = u_shadowRadius;
+	if (0.0 < USE_SCREEN_SPACE_RADIUS)
+	{
+		// is there a better way to do this calculation?
+		float radiusTexCoordX = u_shadowRadius * u_screenTexel.x + texCoord.x;
+		float radiusPositionX = u_ndcToViewMul.x * radiusTexCoordX + u_ndcToViewAdd.x;
+		radius = abs(radiusPositionX * linearDepth - viewSpacePosition.x);
+	}
+
+	float random = JitterNoise(fragCoord);
+	float initialOffset = (0.0 < u_useNoiseOffset) ? (0.5+random) : 1.0;
+
+	mat4 viewToProj = mat4(
+		u_viewToProj0,
+		u_viewToProj1,
+		u_viewToProj2,
+		u_viewToProj3
+	);
+
+	vec4 shadows = vec4_splat(1.0);
+	shadows.x = ScreenSpaceShadow(viewSpacePosition, radius, initialOffset, u_lightPosition0, viewToProj);
+	if (1.5 < u_lightCount)
+	{
+		shadows.y = ScreenSpaceShadow(viewSpacePosition, radius, initialOffset, u_lightPosition1, viewToProj);
+	}
+	if (2.5 < u_lightCount)
+	{
+		shadows.z = ScreenSpaceShadow(viewSpacePosition, radius, initialOffset, u_lightPosition2, viewToProj);
+	}
+	if (3.5 < u_lightCount)
+	{
+		shadows.w = ScreenSpaceShadow(viewSpacePosition, radius, initialOffset, u_lightPosition3, viewToProj);
+	}
+
+	return shadows;
+}
+
+#endif // SCREEN_SPACE_SHADOWS_SH
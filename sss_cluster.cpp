@@ -0,0 +1,153 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "sss_cluster.h"
+
+#include <bx/math.h>
+
+namespace sss
+{
+
+// Lights reaching behind this depth are clamped to it before projecting
+#define CLUSTER_MIN_DEPTH	1e-3f
+
+struct TileRange
+{
+	int32_t m_x0;
+	int32_t m_x1;
+	int32_t m_y0;
+	int32_t m_y1;
+};
+
+static int32_t clampTile(float _coord, int32_t _count)
+{
+	return bx::clamp(int32_t(bx::floor(_coord * float(_count) ) ), 0, _count - 1);
+}
+
+// Tiles covered by a view space box between depths _z0 and _z1. Over the
+// box x/z and y/z are extreme at its corners
+static bool boxTiles(const ClusterParams& _params, const float* _min, const float* _max, float _z0, float _z1, TileRange& _range)
+{
+	float coordMin[2];
+	float coordMax[2];
+	for (uint32_t ii = 0; ii < 2; ++ii)
+	{
+		const float lo = bx::min(_min[ii] / _z0, _min[ii] / _z1);
+		const float hi = bx::max(_max[ii] / _z0, _max[ii] / _z1);
+		const float a = (lo - _params.m_ndcToViewAdd[ii]) / _params.m_ndcToViewMul[ii];
+		const float b = (hi - _params.m_ndcToViewAdd[ii]) / _params.m_ndcToViewMul[ii];
+		coordMin[ii] = bx::min(a, b);
+		coordMax[ii] = bx::max(a, b);
+		if (1.0f < coordMin[ii]
+		||  0.0f > coordMax[ii])
+		{
+			return false;
+		}
+	}
+
+	_range.m_x0 = clampTile(coordMin[0], SSS_CLUSTER_X);
+	_range.m_x1 = clampTile(coordMax[0], SSS_CLUSTER_X);
+	_range.m_y0 = clampTile(coordMin[1], SSS_CLUSTER_Y);
+	_range.m_y1 = clampTile(coordMax[1], SSS_CLUSTER_Y);
+	return true;
+}
+
+void clusterDepthSlice(const ClusterParams& _params, float& _scale, float& _bias)
+{
+	_scale = float(SSS_CLUSTER_Z) / bx::log(_params.m_far / _params.m_near);
+	_bias = -bx::log(_params.m_near) * _scale;
+}
+
+uint32_t buildClusters(const ClusterParams& _params, const ClusterLight* _lights, uint32_t _numLights, float* _clusters, float* _indices)
+{
+	float scale;
+	float bias;
+	clusterDepthSlice(_params, scale, bias);
+
+	uint32_t counts[SSS_CLUSTER_COUNT];
+	uint32_t capacity[SSS_CLUSTER_COUNT];
+	bx::memSet(counts, 0, sizeof(counts) );
+
+	// first pass counts lights per cluster, second writes indices once
+	// offsets are known
+	for (uint32_t pass = 0; pass < 2; ++pass)
+	{
+		for (uint32_t ii = 0; ii < _numLights; ++ii)
+		{
+			const ClusterLight& light = _lights[ii];
+			const float* center = light.m_position;
+			const float radius = light.m_radius;
+			const float zMax = center[2] + radius;
+			if (zMax <= CLUSTER_MIN_DEPTH)
+			{
+				continue;
+			}
+			const float zMin = bx::max(center[2] - radius, CLUSTER_MIN_DEPTH);
+
+			// first and last slices extend to camera and to infinity
+			const int32_t slice0 = bx::clamp(int32_t(bx::floor(bx::log(zMin) * scale + bias) ), 0, SSS_CLUSTER_Z - 1);
+			const int32_t slice1 = bx::clamp(int32_t(bx::floor(bx::log(zMax) * scale + bias) ), 0, SSS_CLUSTER_Z - 1);
+			for (int32_t slice = slice0; slice <= slice1; ++slice)
+			{
+				const float sliceNear = 0 == slice ? zMin : bx::exp( (float(slice) - bias) / scale);
+				const float sliceFar = SSS_CLUSTER_Z - 1 == slice ? zMax : bx::exp( (float(slice + 1) - bias) / scale);
+				const float z0 = bx::max(zMin, sliceNear);
+				const float z1 = bx::min(zMax, sliceFar);
+
+				// widest cross section of sphere within slice
+				const float dz = center[2] < z0 ? z0 - center[2] : (center[2] > z1 ? center[2] - z1 : 0.0f);
+				const float sliceRadius = bx::sqrt(bx::max(radius * radius - dz * dz, 0.0f) );
+				const float boxMin[2] = { center[0] - sliceRadius, center[1] - sliceRadius };
+				const float boxMax[2] = { center[0] + sliceRadius, center[1] + sliceRadius };
+
+				TileRange range;
+				if (!boxTiles(_params, boxMin, boxMax, z0, z1, range) )
+				{
+					continue;
+				}
+
+				for (int32_t yy = range.m_y0; yy <= range.m_y1; ++yy)
+				{
+					for (int32_t xx = range.m_x0; xx <= range.m_x1; ++xx)
+					{
+						const uint32_t cluster = uint32_t(xx + (yy + slice * SSS_CLUSTER_Y) * SSS_CLUSTER_X);
+						if (0 == pass)
+						{
+							++counts[cluster];
+						}
+						else if (counts[cluster] < capacity[cluster])
+						{
+							const uint32_t offset = uint32_t(_clusters[cluster * 2]);
+							_indices[offset + counts[cluster] ] = float(ii);
+							++counts[cluster];
+						}
+					}
+				}
+			}
+		}
+
+		if (0 == pass)
+		{
+			uint32_t offset = 0;
+			for (uint32_t ii = 0; ii < SSS_CLUSTER_COUNT; ++ii)
+			{
+				capacity[ii] = bx::min(bx::min(counts[ii], uint32_t(SSS_CLUSTER_LIGHTS_PER) ), uint32_t(SSS_CLUSTER_MAX_INDICES) - offset);
+				_clusters[ii * 2] = float(offset);
+				offset += capacity[ii];
+				counts[ii] = 0;
+			}
+		}
+	}
+
+	uint32_t numIndices = 0;
+	for (uint32_t ii = 0; ii < SSS_CLUSTER_COUNT; ++ii)
+	{
+		_clusters[ii * 2 + 1] = float(counts[ii]);
+		numIndices += counts[ii];
+	}
+	return numIndices;
+}
+
+} // namespace sss
@@ -0,0 +1,55 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SSS_CLUSTER_H_HEADER_GUARD
+#define SSS_CLUSTER_H_HEADER_GUARD
+
+#include <bx/bx.h>
+
+namespace sss
+{
+	// Must match CLUSTER_* in fs_sss_deferred_combine.sc
+	#define SSS_CLUSTER_X				16
+	#define SSS_CLUSTER_Y				8
+	#define SSS_CLUSTER_Z				24
+	#define SSS_CLUSTER_COUNT			(SSS_CLUSTER_X * SSS_CLUSTER_Y * SSS_CLUSTER_Z)
+	#define SSS_CLUSTER_MAX_LIGHTS		256		// lights in light array
+	#define SSS_CLUSTER_LIGHTS_PER		64		// lights shaded by one cluster
+	#define SSS_CLUSTER_INDEX_WIDTH		256		// width of light index texture
+	#define SSS_CLUSTER_MAX_INDICES		(SSS_CLUSTER_INDEX_WIDTH * 64)
+
+	// View space point light, lighting reaches zero at radius
+	struct ClusterLight
+	{
+		float m_position[3];
+		float m_radius;
+	};
+
+	// Clusters are screen tiles split into depth slices, exponentially
+	// spaced between m_near and m_far so slices stay roughly cube shaped.
+	// Texture coordinates map to view space like NDCToViewspace in shaders,
+	// view.xy = (mul * texCoord + add) * depth.
+	struct ClusterParams
+	{
+		float m_ndcToViewMul[2];
+		float m_ndcToViewAdd[2];
+		float m_near;
+		float m_far;
+	};
+
+	// Slice of view depth is floor(log(depth) * scale + bias)
+	void clusterDepthSlice(const ClusterParams& _params, float& _scale, float& _bias);
+
+	// Assign lights to every cluster their sphere may touch, tested against
+	// each slice's bounds. Writes offset and count into _clusters, two floats
+	// per cluster ordered by x, then y, then slice, and light indices into
+	// _indices. Clusters past SSS_CLUSTER_MAX_INDICES or with more than
+	// SSS_CLUSTER_LIGHTS_PER lights drop the rest. Returns number of indices
+	// written.
+	uint32_t buildClusters(const ClusterParams& _params, const ClusterLight* _lights, uint32_t _numLights, float* _clusters, float* _indices);
+
+} // namespace sss
+
+#endif // SSS_CLUSTER_H_HEADER_GUARD
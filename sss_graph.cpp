@@ -0,0 +1,348 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "sss_graph.h"
+
+#include <bx/bx.h>
+
+namespace sss
+{
+
+static bool isEqual(const TargetDesc& _a, const TargetDesc& _b)
+{
+	return _a.m_width  == _b.m_width
+		&& _a.m_height == _b.m_height
+		&& _a.m_format == _b.m_format
+		&& _a.m_flags  == _b.m_flags
+		;
+}
+
+TargetPool::TargetPool()
+{
+	for (uint32_t ii = 0; ii < SSS_GRAPH_POOL_SIZE; ++ii)
+	{
+		m_entries[ii].m_valid = false;
+	}
+}
+
+void TargetPool::shutdown()
+{
+	for (uint32_t ii = 0; ii < SSS_GRAPH_POOL_SIZE; ++ii)
+	{
+		if (m_entries[ii].m_valid)
+		{
+			destroy(m_entries[ii]);
+		}
+	}
+}
+
+uint16_t TargetPool::acquire(const TargetDesc& _desc, uint32_t _frame)
+{
+	uint16_t freeIdx = SSS_GRAPH_INVALID;
+	uint16_t oldestIdx = SSS_GRAPH_INVALID;
+	for (uint16_t ii = 0; ii < SSS_GRAPH_POOL_SIZE; ++ii)
+	{
+		Entry& entry = m_entries[ii];
+		if (!entry.m_valid)
+		{
+			freeIdx = SSS_GRAPH_INVALID == freeIdx ? ii : freeIdx;
+			continue;
+		}
+
+		if (entry.m_frame == _frame)
+		{
+			continue;
+		}
+
+		if (isEqual(entry.m_desc, _desc) )
+		{
+			entry.m_frame = _frame;
+			return ii;
+		}
+
+		if (SSS_GRAPH_INVALID == oldestIdx
+		||  _frame - m_entries[oldestIdx].m_frame < _frame - entry.m_frame)
+		{
+			oldestIdx = ii;
+		}
+	}
+
+	// when full, evict whichever target has been idle longest
+	if (SSS_GRAPH_INVALID == freeIdx)
+	{
+		BX_ASSERT(SSS_GRAPH_INVALID != oldestIdx, "Render target pool exhausted within one frame");
+		destroy(m_entries[oldestIdx]);
+		freeIdx = oldestIdx;
+	}
+
+	Entry& entry = m_entries[freeIdx];
+	entry.m_desc = _desc;
+	entry.m_texture = bgfx::createTexture2D(_desc.m_width, _desc.m_height, false, 1, _desc.m_format, _desc.m_flags);
+	const bool destroyTextures = true;
+	entry.m_buffer = bgfx::createFrameBuffer(1, &entry.m_texture, destroyTextures);
+	entry.m_frame = _frame;
+	entry.m_valid = true;
+
+	bgfx::TextureInfo info;
+	bgfx::calcTextureSize(info, _desc.m_width, _desc.m_height, 1, false, false, 1, _desc.m_format);
+	entry.m_size = info.storageSize;
+
+	return freeIdx;
+}
+
+void TargetPool::collect(uint32_t _frame, uint32_t _maxAge)
+{
+	for (uint32_t ii = 0; ii < SSS_GRAPH_POOL_SIZE; ++ii)
+	{
+		Entry& entry = m_entries[ii];
+		if (entry.m_valid
+		&&  _maxAge < _frame - entry.m_frame)
+		{
+			destroy(entry);
+		}
+	}
+}
+
+uint32_t TargetPool::getNumTargets() const
+{
+	uint32_t num = 0;
+	for (uint32_t ii = 0; ii < SSS_GRAPH_POOL_SIZE; ++ii)
+	{
+		num += m_entries[ii].m_valid ? 1 : 0;
+	}
+	return num;
+}
+
+uint64_t TargetPool::getMemory() const
+{
+	uint64_t size = 0;
+	for (uint32_t ii = 0; ii < SSS_GRAPH_POOL_SIZE; ++ii)
+	{
+		size += m_entries[ii].m_valid ? m_entries[ii].m_size : 0;
+	}
+	return size;
+}
+
+void TargetPool::destroy(Entry& _entry)
+{
+	// also responsible for destroying texture
+	bgfx::destroy(_entry.m_buffer);
+	_entry.m_valid = false;
+}
+
+RenderGraph::RenderGraph()
+	: m_numPasses(0)
+	, m_numTargets(0)
+	, m_numActivePasses(0)
+	, m_numTransientTargets(0)
+	, m_numPooledTargets(0)
+{
+}
+
+void RenderGraph::shutdown()
+{
+	m_pool.shutdown();
+	reset();
+}
+
+void RenderGraph::reset()
+{
+	m_numPasses = 0;
+	m_numTargets = 0;
+}
+
+uint16_t RenderGraph::createTarget(const char* _name, const TargetDesc& _desc)
+{
+	BX_ASSERT(m_numTargets < SSS_GRAPH_MAX_TARGETS, "Too many render graph targets");
+	Target& target = m_targets[m_numTargets];
+	target.m_name = _name;
+	target.m_desc = _desc;
+	target.m_texture = BGFX_INVALID_HANDLE;
+	target.m_buffer = BGFX_INVALID_HANDLE;
+	target.m_transient = true;
+	return m_numTargets++;
+}
+
+uint16_t RenderGraph::importTarget(const char* _name, bgfx::TextureHandle _texture, bgfx::FrameBufferHandle _buffer)
+{
+	BX_ASSERT(m_numTargets < SSS_GRAPH_MAX_TARGETS, "Too many render graph targets");
+	Target& target = m_targets[m_numTargets];
+	target.m_name = _name;
+	target.m_texture = _texture;
+	target.m_buffer = _buffer;
+	target.m_transient = false;
+	return m_numTargets++;
+}
+
+uint16_t RenderGraph::addPass(const char* _name, bool _root)
+{
+	BX_ASSERT(m_numPasses < SSS_GRAPH_MAX_PASSES, "Too many render graph passes");
+	Pass& pass = m_passes[m_numPasses];
+	pass.m_name = _name;
+	pass.m_numReads = 0;
+	pass.m_numWrites = 0;
+	pass.m_view = 0;
+	pass.m_root = _root;
+	pass.m_active = false;
+	return m_numPasses++;
+}
+
+void RenderGraph::read(uint16_t _pass, uint16_t _target)
+{
+	if (SSS_GRAPH_INVALID != _target)
+	{
+		Pass& pass = m_passes[_pass];
+		BX_ASSERT(pass.m_numReads < SSS_GRAPH_MAX_READS, "Too many reads in pass %s", pass.m_name);
+		pass.m_reads[pass.m_numReads++] = _target;
+	}
+}
+
+void RenderGraph::write(uint16_t _pass, uint16_t _target)
+{
+	if (SSS_GRAPH_INVALID != _target)
+	{
+		Pass& pass = m_passes[_pass];
+		BX_ASSERT(pass.m_numWrites < SSS_GRAPH_MAX_WRITES, "Too many writes in pass %s", pass.m_name);
+		pass.m_writes[pass.m_numWrites++] = _target;
+	}
+}
+
+void RenderGraph::compile(bgfx::ViewId _firstView, uint32_t _frame, uint32_t _maxAge)
+{
+	// walk back from roots, a pass is needed when it writes a target read by
+	// a later pass that is needed
+	bool needed[SSS_GRAPH_MAX_TARGETS];
+	for (uint16_t ii = 0; ii < m_numTargets; ++ii)
+	{
+		needed[ii] = false;
+	}
+	for (int32_t ii = int32_t(m_numPasses) - 1; 0 <= ii; --ii)
+	{
+		Pass& pass = m_passes[ii];
+		pass.m_active = pass.m_root;
+		for (uint8_t jj = 0; jj < pass.m_numWrites; ++jj)
+		{
+			pass.m_active |= needed[pass.m_writes[jj] ];
+		}
+
+		if (pass.m_active)
+		{
+			for (uint8_t jj = 0; jj < pass.m_numReads; ++jj)
+			{
+				needed[pass.m_reads[jj] ] = true;
+			}
+		}
+	}
+
+	// lifetime of each target over remaining passes
+	for (uint16_t ii = 0; ii < m_numTargets; ++ii)
+	{
+		m_targets[ii].m_pooled = SSS_GRAPH_INVALID;
+		m_targets[ii].m_firstUse = SSS_GRAPH_INVALID;
+		m_targets[ii].m_lastUse = 0;
+	}
+	for (uint16_t ii = 0; ii < m_numPasses; ++ii)
+	{
+		const Pass& pass = m_passes[ii];
+		if (!pass.m_active)
+		{
+			continue;
+		}
+
+		for (uint8_t jj = 0; jj < pass.m_numReads + pass.m_numWrites; ++jj)
+		{
+			Target& target = m_targets[jj < pass.m_numReads ? pass.m_reads[jj] : pass.m_writes[jj - pass.m_numReads] ];
+			target.m_firstUse = bx::min(target.m_firstUse, ii);
+			target.m_lastUse = bx::max(target.m_lastUse, ii);
+		}
+	}
+
+	m_pool.collect(_frame, _maxAge);
+
+	// in pass order, targets first used by a pass take a pooled target given
+	// back by an earlier pass if one matches, and give it back after last use
+	uint16_t released[SSS_GRAPH_MAX_TARGETS];
+	uint16_t numReleased = 0;
+	m_numActivePasses = 0;
+	m_numTransientTargets = 0;
+	m_numPooledTargets = 0;
+	bgfx::ViewId view = _firstView;
+	for (uint16_t ii = 0; ii < m_numPasses; ++ii)
+	{
+		Pass& pass = m_passes[ii];
+		if (!pass.m_active)
+		{
+			continue;
+		}
+
+		pass.m_view = view++;
+		bgfx::resetView(pass.m_view);
+		bgfx::setViewName(pass.m_view, pass.m_name);
+		++m_numActivePasses;
+
+		for (uint16_t jj = 0; jj < m_numTargets; ++jj)
+		{
+			Target& target = m_targets[jj];
+			if (!target.m_transient
+			||  target.m_firstUse != ii)
+			{
+				continue;
+			}
+
+			++m_numTransientTargets;
+			for (uint16_t kk = 0; kk < numReleased; ++kk)
+			{
+				const Target& previous = m_targets[released[kk] ];
+				if (isEqual(previous.m_desc, target.m_desc) )
+				{
+					target.m_pooled = previous.m_pooled;
+					released[kk] = released[--numReleased];
+					break;
+				}
+			}
+
+			if (SSS_GRAPH_INVALID == target.m_pooled)
+			{
+				target.m_pooled = m_pool.acquire(target.m_desc, _frame);
+				++m_numPooledTargets;
+			}
+			target.m_texture = m_pool.getTexture(target.m_pooled);
+			target.m_buffer = m_pool.getBuffer(target.m_pooled);
+		}
+
+		for (uint16_t jj = 0; jj < m_numTargets; ++jj)
+		{
+			const Target& target = m_targets[jj];
+			if (target.m_transient
+			&&  SSS_GRAPH_INVALID != target.m_pooled
+			&&  target.m_lastUse == ii)
+			{
+				released[numReleased++] = jj;
+			}
+		}
+	}
+}
+
+bgfx::TextureHandle RenderGraph::getTexture(uint16_t _target) const
+{
+	if (SSS_GRAPH_INVALID == _target)
+	{
+		bgfx::TextureHandle invalid = BGFX_INVALID_HANDLE;
+		return invalid;
+	}
+	return m_targets[_target].m_texture;
+}
+
+bgfx::FrameBufferHandle RenderGraph::getBuffer(uint16_t _target) const
+{
+	if (SSS_GRAPH_INVALID == _target)
+	{
+		bgfx::FrameBufferHandle invalid = BGFX_INVALID_HANDLE;
+		return invalid;
+	}
+	return m_targets[_target].m_buffer;
+}
+
+} // namespace sss
@@ -0,0 +1,184 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SSS_GRAPH_H_HEADER_GUARD
+#define SSS_GRAPH_H_HEADER_GUARD
+
+#include <bgfx/bgfx.h>
+
+namespace sss
+{
+	#define SSS_GRAPH_MAX_PASSES	32
+	#define SSS_GRAPH_MAX_TARGETS	32
+	#define SSS_GRAPH_MAX_READS		8
+	#define SSS_GRAPH_MAX_WRITES	4
+	#define SSS_GRAPH_POOL_SIZE		32
+	#define SSS_GRAPH_INVALID		UINT16_MAX
+
+	struct TargetDesc
+	{
+		uint16_t m_width;
+		uint16_t m_height;
+		bgfx::TextureFormat::Enum m_format;
+		uint64_t m_flags;
+	};
+
+	// Single texture render targets kept between frames and handed out by
+	// description, so passes toggled on and off don't reallocate them.
+	// Targets that haven't been handed out for a while are destroyed.
+	class TargetPool
+	{
+	public:
+		TargetPool();
+
+		void shutdown();
+
+		// Index of a target matching _desc not already taken this frame,
+		// created when there is none
+		uint16_t acquire(const TargetDesc& _desc, uint32_t _frame);
+
+		// Destroy targets not taken within the last _maxAge frames
+		void collect(uint32_t _frame, uint32_t _maxAge);
+
+		bgfx::TextureHandle getTexture(uint16_t _idx) const
+		{
+			return m_entries[_idx].m_texture;
+		}
+
+		bgfx::FrameBufferHandle getBuffer(uint16_t _idx) const
+		{
+			return m_entries[_idx].m_buffer;
+		}
+
+		uint32_t getNumTargets() const;
+
+		// Bytes of texture memory held by pool
+		uint64_t getMemory() const;
+
+	private:
+		struct Entry
+		{
+			TargetDesc m_desc;
+			bgfx::TextureHandle m_texture;
+			bgfx::FrameBufferHandle m_buffer;
+			uint32_t m_size;
+			uint32_t m_frame;
+			bool m_valid;
+		};
+
+		void destroy(Entry& _entry);
+
+		Entry m_entries[SSS_GRAPH_POOL_SIZE];
+	};
+
+	// Passes of one frame, declared in submission order along with the
+	// targets they read and write. Compile culls passes whose results
+	// nothing needs, gives the rest consecutive views, and backs transient
+	// targets with pooled ones. Transient targets of equal description share
+	// a pooled target when their lifetimes don't overlap. Imported targets,
+	// like the gbuffer or history, are owned by the caller and only take
+	// part in culling.
+	class RenderGraph
+	{
+	public:
+		RenderGraph();
+
+		void shutdown();
+
+		// Start declaring a new frame
+		void reset();
+
+		uint16_t createTarget(const char* _name, const TargetDesc& _desc);
+		uint16_t importTarget(const char* _name, bgfx::TextureHandle _texture, bgfx::FrameBufferHandle _buffer);
+
+		// Root passes are never culled, like those writing to the backbuffer
+		// or reading back to cpu
+		uint16_t addPass(const char* _name, bool _root = false);
+
+		// Invalid targets are ignored, so optional inputs need no branch
+		void read(uint16_t _pass, uint16_t _target);
+		void write(uint16_t _pass, uint16_t _target);
+
+		// Cull, assign views from _firstView and assign pooled targets.
+		// Views are reset and named after their pass
+		void compile(bgfx::ViewId _firstView, uint32_t _frame, uint32_t _maxAge);
+
+		bool isActive(uint16_t _pass) const
+		{
+			return SSS_GRAPH_INVALID != _pass && m_passes[_pass].m_active;
+		}
+
+		bgfx::ViewId getView(uint16_t _pass) const
+		{
+			return m_passes[_pass].m_view;
+		}
+
+		bgfx::TextureHandle getTexture(uint16_t _target) const;
+		bgfx::FrameBufferHandle getBuffer(uint16_t _target) const;
+
+		uint32_t getNumPasses() const
+		{
+			return m_numPasses;
+		}
+
+		uint32_t getNumActivePasses() const
+		{
+			return m_numActivePasses;
+		}
+
+		uint32_t getNumTransientTargets() const
+		{
+			return m_numTransientTargets;
+		}
+
+		// Pooled targets backing this frame's transient targets
+		uint32_t getNumPooledTargets() const
+		{
+			return m_numPooledTargets;
+		}
+
+		const TargetPool& getPool() const
+		{
+			return m_pool;
+		}
+
+	private:
+		struct Pass
+		{
+			const char* m_name;
+			uint16_t m_reads[SSS_GRAPH_MAX_READS];
+			uint16_t m_writes[SSS_GRAPH_MAX_WRITES];
+			uint8_t m_numReads;
+			uint8_t m_numWrites;
+			bgfx::ViewId m_view;
+			bool m_root;
+			bool m_active;
+		};
+
+		struct Target
+		{
+			const char* m_name;
+			TargetDesc m_desc;
+			bgfx::TextureHandle m_texture;
+			bgfx::FrameBufferHandle m_buffer;
+			uint16_t m_pooled;
+			uint16_t m_firstUse;
+			uint16_t m_lastUse;
+			bool m_transient;
+		};
+
+		Pass m_passes[SSS_GRAPH_MAX_PASSES];
+		Target m_targets[SSS_GRAPH_MAX_TARGETS];
+		TargetPool m_pool;
+		uint16_t m_numPasses;
+		uint16_t m_numTargets;
+		uint32_t m_numActivePasses;
+		uint32_t m_numTransientTargets;
+		uint32_t m_numPooledTargets;
+	};
+
+} // namespace sss
+
+#endif // SSS_GRAPH_H_HEADER_GUARD
@@ -0,0 +1,111 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "sss_jobs.h"
+
+#include <bx/math.h>
+#include <bx/cpu.h>
+
+namespace sss
+{
+
+JobPool::JobPool()
+	: m_fn(NULL)
+	, m_userData(NULL)
+	, m_numJobs(0)
+	, m_nextJob(0)
+	, m_numWorkers(0)
+	, m_quit(false)
+{
+}
+
+void JobPool::init(uint32_t _numWorkers)
+{
+	m_quit = false;
+	m_numWorkers = bx::min(_numWorkers, uint32_t(SSS_JOBS_MAX_WORKERS) );
+	for (uint32_t ii = 0; ii < m_numWorkers; ++ii)
+	{
+		Worker& worker = m_workers[ii];
+		worker.m_pool = this;
+		worker.m_idx = ii + 1;
+		worker.m_thread.init(threadFunc, &worker, 0, "sss job");
+	}
+}
+
+void JobPool::shutdown()
+{
+	m_quit = true;
+	for (uint32_t ii = 0; ii < m_numWorkers; ++ii)
+	{
+		m_workers[ii].m_start.post();
+	}
+
+	for (uint32_t ii = 0; ii < m_numWorkers; ++ii)
+	{
+		m_workers[ii].m_thread.shutdown();
+	}
+
+	m_numWorkers = 0;
+}
+
+void JobPool::run(JobFn _fn, void* _userData, uint32_t _numJobs, uint32_t _numThreads)
+{
+	m_fn = _fn;
+	m_userData = _userData;
+	m_numJobs = _numJobs;
+	m_nextJob = 0;
+
+	// no point waking more workers than there are jobs
+	const uint32_t numWorkers = bx::min(bx::max(_numThreads, 1u) - 1, m_numWorkers, _numJobs);
+	for (uint32_t ii = 0; ii < numWorkers; ++ii)
+	{
+		m_workers[ii].m_start.post();
+	}
+
+	work(0);
+
+	for (uint32_t ii = 0; ii < numWorkers; ++ii)
+	{
+		m_done.wait();
+	}
+}
+
+int32_t JobPool::threadFunc(bx::Thread* _thread, void* _userData)
+{
+	BX_UNUSED(_thread);
+	Worker* worker = (Worker*)_userData;
+	JobPool* pool = worker->m_pool;
+
+	for (;;)
+	{
+		worker->m_start.wait();
+		if (pool->m_quit)
+		{
+			break;
+		}
+
+		pool->work(worker->m_idx);
+		pool->m_done.post();
+	}
+
+	return 0;
+}
+
+// take jobs until none are left
+void JobPool::work(uint32_t _threadIdx)
+{
+	for (;;)
+	{
+		const uint32_t job = uint32_t(bx::atomicFetchAndAdd(&m_nextJob, 1) );
+		if (m_numJobs <= job)
+		{
+			break;
+		}
+
+		m_fn(m_userData, job, _threadIdx);
+	}
+}
+
+} // namespace sss
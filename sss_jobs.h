@@ -0,0 +1,65 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SSS_JOBS_H_HEADER_GUARD
+#define SSS_JOBS_H_HEADER_GUARD
+
+#include <bx/bx.h>
+#include <bx/thread.h>
+#include <bx/semaphore.h>
+
+namespace sss
+{
+	#define SSS_JOBS_MAX_WORKERS	63
+
+	// _threadIdx is 0 for calling thread, workers are 1 and up
+	typedef void (*JobFn)(void* _userData, uint32_t _jobIdx, uint32_t _threadIdx);
+
+	// Fixed set of worker threads waiting on semaphores, so handing out work
+	// every frame doesn't create threads. Calling thread takes jobs as well.
+	class JobPool
+	{
+	public:
+		JobPool();
+
+		void init(uint32_t _numWorkers);
+		void shutdown();
+
+		// Including calling thread
+		uint32_t getNumThreads() const
+		{
+			return m_numWorkers + 1;
+		}
+
+		// Run _numJobs jobs on up to _numThreads threads and return when all
+		// are done. Jobs are taken in order, but may finish in any order.
+		void run(JobFn _fn, void* _userData, uint32_t _numJobs, uint32_t _numThreads);
+
+	private:
+		struct Worker
+		{
+			bx::Thread m_thread;
+			bx::Semaphore m_start;
+			JobPool* m_pool;
+			uint32_t m_idx;
+		};
+
+		static int32_t threadFunc(bx::Thread* _thread, void* _userData);
+		void work(uint32_t _threadIdx);
+
+		Worker m_workers[SSS_JOBS_MAX_WORKERS];
+		bx::Semaphore m_done;
+
+		JobFn m_fn;
+		void* m_userData;
+		uint32_t m_numJobs;
+		int32_t m_nextJob;
+		uint32_t m_numWorkers;
+		bool m_quit;
+	};
+
+} // namespace sss
+
+#endif // SSS_JOBS_H_HEADER_GUARD
@@ -0,0 +1,69 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "sss_loader.h"
+
+#include <bx/cpu.h>
+
+namespace sss
+{
+
+AssetLoader::AssetLoader()
+	: m_fn(NULL)
+	, m_userData(NULL)
+	, m_numJobs(0)
+	, m_numFinished(0)
+	, m_quit(0)
+	, m_started(false)
+{
+}
+
+void AssetLoader::start(LoadFn _fn, void* _userData, uint32_t _numJobs)
+{
+	m_fn = _fn;
+	m_userData = _userData;
+	m_numJobs = _numJobs;
+	m_numFinished = 0;
+	m_quit = 0;
+	m_started = true;
+	m_thread.init(threadFunc, this, 0, "sss loader");
+}
+
+void AssetLoader::shutdown()
+{
+	if (m_started)
+	{
+		bx::atomicFetchAndAdd(&m_quit, 1);
+		m_thread.shutdown();
+		m_started = false;
+	}
+}
+
+uint32_t AssetLoader::getNumFinished()
+{
+	// full barrier, so results written before the count are visible too
+	return uint32_t(bx::atomicFetchAndAdd(&m_numFinished, 0) );
+}
+
+int32_t AssetLoader::threadFunc(bx::Thread* _thread, void* _userData)
+{
+	BX_UNUSED(_thread);
+	AssetLoader* loader = (AssetLoader*)_userData;
+
+	for (uint32_t ii = 0; ii < loader->m_numJobs; ++ii)
+	{
+		if (0 != bx::atomicFetchAndAdd(&loader->m_quit, 0) )
+		{
+			break;
+		}
+
+		loader->m_fn(loader->m_userData, ii);
+		bx::atomicFetchAndAdd(&loader->m_numFinished, 1);
+	}
+
+	return 0;
+}
+
+} // namespace sss
@@ -0,0 +1,52 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SSS_LOADER_H_HEADER_GUARD
+#define SSS_LOADER_H_HEADER_GUARD
+
+#include <bx/bx.h>
+#include <bx/thread.h>
+
+namespace sss
+{
+	typedef void (*LoadFn)(void* _userData, uint32_t _jobIdx);
+
+	// Single background thread running load jobs in order. Main thread polls
+	// how many have finished and picks up their results, so assets loaded
+	// first can be used while later ones are still loading.
+	class AssetLoader
+	{
+	public:
+		AssetLoader();
+
+		void start(LoadFn _fn, void* _userData, uint32_t _numJobs);
+
+		// Skip jobs not started yet and wait for current one
+		void shutdown();
+
+		// Jobs are finished in order, results of jobs below this are ready
+		uint32_t getNumFinished();
+
+		uint32_t getNumJobs() const
+		{
+			return m_numJobs;
+		}
+
+	private:
+		static int32_t threadFunc(bx::Thread* _thread, void* _userData);
+
+		bx::Thread m_thread;
+
+		LoadFn m_fn;
+		void* m_userData;
+		uint32_t m_numJobs;
+		int32_t m_numFinished;
+		int32_t m_quit;
+		bool m_started;
+	};
+
+} // namespace sss
+
+#endif // SSS_LOADER_H_HEADER_GUARD
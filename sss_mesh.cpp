@@ -0,0 +1,489 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "sss_mesh.h"
+
+#include <bgfx_utils.h>
+#include <entry/entry.h>
+#include <bx/cpu.h>
+#include <bx/file.h>
+#include <bx/math.h>
+#include <bx/string.h>
+
+#if BX_PLATFORM_WINDOWS
+#	include <windows.h>
+#elif BX_PLATFORM_POSIX
+#	include <fcntl.h>
+#	include <sys/mman.h>
+#	include <sys/stat.h>
+#	include <unistd.h>
+#endif
+
+namespace sss
+{
+
+#define MESH_MAGIC		BX_MAKEFOURCC('S', 'S', 'M', 'B')
+#define MESH_VERSION	2
+
+// Data of each group starts aligned, so buffers can be created in place
+#define MESH_ALIGN		16
+
+// Group bounds grow by half a quantization step on each axis
+#define MESH_QUANT_MARGIN	(0.5f * 1.7320508f / 32767.0f)
+
+struct MeshHeader
+{
+	uint32_t m_magic;
+	uint32_t m_version;
+	float m_dequantize[4]; // center in xyz, extent in w
+	uint32_t m_numGroups;
+	uint32_t m_padding;
+	uint64_t m_sourceSize; // source mesh the file was baked from
+	uint64_t m_sourceModified;
+};
+
+struct GroupHeader
+{
+	float m_sphere[4]; // quantized space
+	float m_aabbMin[3];
+	float m_aabbMax[3];
+	uint32_t m_numVertices;
+	uint32_t m_numIndices;
+	uint32_t m_vertexOffset; // from start of file
+	uint32_t m_indexOffset;
+};
+
+struct BakedVertex
+{
+	int16_t m_position[4];
+	int16_t m_normal[2];
+	int16_t m_texcoord[2];
+};
+
+BX_STATIC_ASSERT(16 == sizeof(BakedVertex) );
+
+static bgfx::VertexLayout s_layout;
+
+void bakedMeshInit()
+{
+	s_layout
+		.begin()
+		.add(bgfx::Attrib::Position,  4, bgfx::AttribType::Int16, true)
+		.add(bgfx::Attrib::Normal,    2, bgfx::AttribType::Int16, true)
+		.add(bgfx::Attrib::TexCoord0, 2, bgfx::AttribType::Int16, true)
+		.end();
+}
+
+static int16_t toSnorm16(float _value)
+{
+	return int16_t(bx::round(bx::clamp(_value, -1.0f, 1.0f) * 32767.0f) );
+}
+
+// Same as float32x3_to_oct in normal_encoding.sh, input needn't be normalized
+static void octEncode(float _oct[2], const float _normal[3])
+{
+	const float l1 = bx::abs(_normal[0]) + bx::abs(_normal[1]) + bx::abs(_normal[2]);
+	const float invL1 = 1.0f / bx::max(l1, 1e-6f);
+	const float px = _normal[0] * invL1;
+	const float py = _normal[1] * invL1;
+
+	if (_normal[2] <= 0.0f)
+	{
+		_oct[0] = (1.0f - bx::abs(py) ) * (0.0f <= px ? 1.0f : -1.0f);
+		_oct[1] = (1.0f - bx::abs(px) ) * (0.0f <= py ? 1.0f : -1.0f);
+	}
+	else
+	{
+		_oct[0] = px;
+		_oct[1] = py;
+	}
+}
+
+static uint32_t alignUp(uint32_t _offset)
+{
+	return (_offset + MESH_ALIGN - 1) / MESH_ALIGN * MESH_ALIGN;
+}
+
+static void writePadding(bx::WriterI* _writer, uint32_t _size)
+{
+	const uint8_t zero[MESH_ALIGN] = {};
+	bx::write(_writer, zero, int32_t(_size) );
+}
+
+// Size and last write time of source mesh, false when it can't be found.
+// Time is whatever unit the platform reports, only compared for equality
+static bool sourceStamp(const char* _filePath, uint64_t& _size, uint64_t& _modified)
+{
+#if BX_PLATFORM_WINDOWS
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if (!GetFileAttributesExA(_filePath, GetFileExInfoStandard, &data) )
+	{
+		return false;
+	}
+	_size = (uint64_t(data.nFileSizeHigh) << 32) | data.nFileSizeLow;
+	_modified = (uint64_t(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+#elif BX_PLATFORM_POSIX
+	struct stat st;
+	if (0 != ::stat(_filePath, &st) )
+	{
+		return false;
+	}
+	_size = uint64_t(st.st_size);
+	_modified = uint64_t(st.st_mtime);
+#else
+	bx::FileReader reader;
+	if (!bx::open(&reader, _filePath) )
+	{
+		return false;
+	}
+	_size = uint64_t(bx::getSize(&reader) );
+	_modified = 0;
+	bx::close(&reader);
+#endif
+	return true;
+}
+
+void bakedMeshPath(char* _out, uint32_t _size, const char* _filePath)
+{
+	// extension starts at last dot after last separator
+	const int32_t len = bx::strLen(_filePath);
+	int32_t ext = len;
+	for (int32_t ii = len - 1; 0 <= ii && '/' != _filePath[ii] && '\\' != _filePath[ii]; --ii)
+	{
+		if ('.' == _filePath[ii])
+		{
+			ext = ii;
+			break;
+		}
+	}
+	bx::snprintf(_out, _size, "%.*s.baked", ext, _filePath);
+}
+
+bool bakeMesh(const Mesh* _mesh, const char* _filePath, const char* _sourcePath)
+{
+	const bgfx::VertexLayout& layout = _mesh->m_layout;
+	const uint32_t numGroups = uint32_t(_mesh->m_groups.size() );
+
+	// one extent for all axes, so dequantizing is a uniform scale that folds
+	// into the model's transform
+	bx::Vec3 boundsMin = {  bx::kFloatMax,  bx::kFloatMax,  bx::kFloatMax };
+	bx::Vec3 boundsMax = { -bx::kFloatMax, -bx::kFloatMax, -bx::kFloatMax };
+	for (uint32_t ii = 0; ii < numGroups; ++ii)
+	{
+		const Group& group = _mesh->m_groups[ii];
+		if (NULL == group.m_vertices
+		||  NULL == group.m_indices)
+		{
+			return false;
+		}
+
+		for (uint32_t vv = 0; vv < group.m_numVertices; ++vv)
+		{
+			float position[4];
+			bgfx::vertexUnpack(position, bgfx::Attrib::Position, layout, group.m_vertices, vv);
+			boundsMin = bx::min(boundsMin, { position[0], position[1], position[2] });
+			boundsMax = bx::max(boundsMax, { position[0], position[1], position[2] });
+		}
+	}
+
+	const bx::Vec3 center = bx::mul(bx::add(boundsMin, boundsMax), 0.5f);
+	const bx::Vec3 halfSize = bx::mul(bx::sub(boundsMax, boundsMin), 0.5f);
+	const float extent = bx::max(bx::max(halfSize.x, halfSize.y, halfSize.z), 1e-6f);
+	const float invExtent = 1.0f / extent;
+
+	MeshHeader header;
+	header.m_magic = MESH_MAGIC;
+	header.m_version = MESH_VERSION;
+	header.m_dequantize[0] = center.x;
+	header.m_dequantize[1] = center.y;
+	header.m_dequantize[2] = center.z;
+	header.m_dequantize[3] = extent;
+	header.m_numGroups = numGroups;
+	header.m_padding = 0;
+	header.m_sourceSize = 0;
+	header.m_sourceModified = 0;
+	sourceStamp(_sourcePath, header.m_sourceSize, header.m_sourceModified);
+
+	// group data follows all headers
+	GroupHeader* groups = (GroupHeader*)BX_ALLOC(entry::getAllocator(), bx::max(numGroups, 1u) * sizeof(GroupHeader) );
+	uint32_t offset = sizeof(MeshHeader) + numGroups * sizeof(GroupHeader);
+	for (uint32_t ii = 0; ii < numGroups; ++ii)
+	{
+		const Group& group = _mesh->m_groups[ii];
+		GroupHeader& groupHeader = groups[ii];
+
+		const bx::Vec3 sphereCenter = bx::mul(bx::sub(group.m_sphere.center, center), invExtent);
+		const bx::Vec3 aabbMin = bx::mul(bx::sub(group.m_aabb.min, center), invExtent);
+		const bx::Vec3 aabbMax = bx::mul(bx::sub(group.m_aabb.max, center), invExtent);
+		groupHeader.m_sphere[0] = sphereCenter.x;
+		groupHeader.m_sphere[1] = sphereCenter.y;
+		groupHeader.m_sphere[2] = sphereCenter.z;
+		groupHeader.m_sphere[3] = group.m_sphere.radius * invExtent + MESH_QUANT_MARGIN;
+		groupHeader.m_aabbMin[0] = aabbMin.x - MESH_QUANT_MARGIN;
+		groupHeader.m_aabbMin[1] = aabbMin.y - MESH_QUANT_MARGIN;
+		groupHeader.m_aabbMin[2] = aabbMin.z - MESH_QUANT_MARGIN;
+		groupHeader.m_aabbMax[0] = aabbMax.x + MESH_QUANT_MARGIN;
+		groupHeader.m_aabbMax[1] = aabbMax.y + MESH_QUANT_MARGIN;
+		groupHeader.m_aabbMax[2] = aabbMax.z + MESH_QUANT_MARGIN;
+
+		groupHeader.m_numVertices = group.m_numVertices;
+		groupHeader.m_numIndices = group.m_numIndices;
+		groupHeader.m_vertexOffset = alignUp(offset);
+		offset = groupHeader.m_vertexOffset + group.m_numVertices * sizeof(BakedVertex);
+		groupHeader.m_indexOffset = alignUp(offset);
+		offset = groupHeader.m_indexOffset + group.m_numIndices * sizeof(uint16_t);
+	}
+
+	bx::FileWriter writer;
+	if (!bx::open(&writer, _filePath) )
+	{
+		BX_FREE(entry::getAllocator(), groups);
+		return false;
+	}
+
+	bx::write(&writer, header);
+	bx::write(&writer, groups, int32_t(numGroups * sizeof(GroupHeader) ) );
+
+	const bool hasNormal = layout.has(bgfx::Attrib::Normal);
+	const bool hasTexCoord = layout.has(bgfx::Attrib::TexCoord0);
+	offset = sizeof(MeshHeader) + numGroups * sizeof(GroupHeader);
+	for (uint32_t ii = 0; ii < numGroups; ++ii)
+	{
+		const Group& group = _mesh->m_groups[ii];
+		const GroupHeader& groupHeader = groups[ii];
+
+		writePadding(&writer, groupHeader.m_vertexOffset - offset);
+		for (uint32_t vv = 0; vv < group.m_numVertices; ++vv)
+		{
+			float position[4];
+			bgfx::vertexUnpack(position, bgfx::Attrib::Position, layout, group.m_vertices, vv);
+
+			// normals are stored biased, same unpack as vs_sss_gbuffer.sc
+			float normal[4] = { 0.5f, 1.0f, 0.5f, 0.0f };
+			if (hasNormal)
+			{
+				bgfx::vertexUnpack(normal, bgfx::Attrib::Normal, layout, group.m_vertices, vv);
+			}
+			normal[0] = normal[0] * 2.0f - 1.0f;
+			normal[1] = normal[1] * 2.0f - 1.0f;
+			normal[2] = normal[2] * 2.0f - 1.0f;
+			float oct[2];
+			octEncode(oct, normal);
+
+			float texCoord[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+			if (hasTexCoord)
+			{
+				bgfx::vertexUnpack(texCoord, bgfx::Attrib::TexCoord0, layout, group.m_vertices, vv);
+			}
+
+			BakedVertex vertex;
+			vertex.m_position[0] = toSnorm16( (position[0] - center.x) * invExtent);
+			vertex.m_position[1] = toSnorm16( (position[1] - center.y) * invExtent);
+			vertex.m_position[2] = toSnorm16( (position[2] - center.z) * invExtent);
+			vertex.m_position[3] = toSnorm16(1.0f);
+			vertex.m_normal[0] = toSnorm16(oct[0]);
+			vertex.m_normal[1] = toSnorm16(oct[1]);
+			vertex.m_texcoord[0] = toSnorm16(texCoord[0] / SSS_MESH_UV_RANGE);
+			vertex.m_texcoord[1] = toSnorm16(texCoord[1] / SSS_MESH_UV_RANGE);
+			bx::write(&writer, vertex);
+		}
+		offset = groupHeader.m_vertexOffset + group.m_numVertices * sizeof(BakedVertex);
+
+		writePadding(&writer, groupHeader.m_indexOffset - offset);
+		bx::write(&writer, group.m_indices, int32_t(group.m_numIndices * sizeof(uint16_t) ) );
+		offset = groupHeader.m_indexOffset + group.m_numIndices * sizeof(uint16_t);
+	}
+
+	bx::close(&writer);
+	BX_FREE(entry::getAllocator(), groups);
+	return true;
+}
+
+struct MappedFile
+{
+	const uint8_t* m_data;
+	uint32_t m_size;
+	int32_t m_refs;
+};
+
+static MappedFile* mapFile(const char* _filePath)
+{
+	const uint8_t* data = NULL;
+	uint32_t size = 0;
+
+#if BX_PLATFORM_WINDOWS
+	HANDLE file = CreateFileA(_filePath, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (INVALID_HANDLE_VALUE != file)
+	{
+		LARGE_INTEGER fileSize;
+		if (GetFileSizeEx(file, &fileSize)
+		&&  0 < fileSize.QuadPart)
+		{
+			HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+			if (NULL != mapping)
+			{
+				// view keeps mapping alive after handles are closed
+				data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+				size = uint32_t(fileSize.QuadPart);
+				CloseHandle(mapping);
+			}
+		}
+		CloseHandle(file);
+	}
+#elif BX_PLATFORM_POSIX
+	const int fd = ::open(_filePath, O_RDONLY);
+	if (0 <= fd)
+	{
+		struct stat st;
+		if (0 == fstat(fd, &st)
+		&&  0 < st.st_size)
+		{
+			void* mapped = mmap(NULL, size_t(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+			if (MAP_FAILED != mapped)
+			{
+				data = (const uint8_t*)mapped;
+				size = uint32_t(st.st_size);
+			}
+		}
+
+		// mapping stays valid after closing descriptor
+		::close(fd);
+	}
+#else
+	// no file mapping, read whole file instead
+	bx::FileReader reader;
+	if (bx::open(&reader, _filePath) )
+	{
+		size = uint32_t(bx::getSize(&reader) );
+		uint8_t* buffer = (uint8_t*)BX_ALLOC(entry::getAllocator(), bx::max(size, 1u) );
+		bx::read(&reader, buffer, int32_t(size) );
+		bx::close(&reader);
+		data = buffer;
+	}
+#endif
+
+	if (NULL == data)
+	{
+		return NULL;
+	}
+
+	MappedFile* mappedFile = BX_NEW(entry::getAllocator(), MappedFile);
+	mappedFile->m_data = data;
+	mappedFile->m_size = size;
+	mappedFile->m_refs = 0;
+	return mappedFile;
+}
+
+static void unmapFile(MappedFile* _file)
+{
+#if BX_PLATFORM_WINDOWS
+	UnmapViewOfFile(_file->m_data);
+#elif BX_PLATFORM_POSIX
+	munmap(const_cast<uint8_t*>(_file->m_data), _file->m_size);
+#else
+	BX_FREE(entry::getAllocator(), const_cast<uint8_t*>(_file->m_data) );
+#endif
+	BX_DELETE(entry::getAllocator(), _file);
+}
+
+// Called for each buffer once bgfx has uploaded it, from render thread
+static void releaseMappedFile(void* _ptr, void* _userData)
+{
+	BX_UNUSED(_ptr);
+	MappedFile* file = (MappedFile*)_userData;
+	if (0 == bx::atomicAddAndFetch(&file->m_refs, -1) )
+	{
+		unmapFile(file);
+	}
+}
+
+static bool isValid(const MappedFile* _file)
+{
+	const MeshHeader* header = (const MeshHeader*)_file->m_data;
+	if (_file->m_size < sizeof(MeshHeader)
+	||  MESH_MAGIC != header->m_magic
+	||  MESH_VERSION != header->m_version
+	||  (_file->m_size - sizeof(MeshHeader) ) / sizeof(GroupHeader) < header->m_numGroups)
+	{
+		return false;
+	}
+
+	const GroupHeader* groups = (const GroupHeader*)(header + 1);
+	for (uint32_t ii = 0; ii < header->m_numGroups; ++ii)
+	{
+		const GroupHeader& group = groups[ii];
+		if (UINT16_MAX < group.m_numVertices
+		||  _file->m_size < uint64_t(group.m_vertexOffset) + group.m_numVertices * sizeof(BakedVertex)
+		||  _file->m_size < uint64_t(group.m_indexOffset) + group.m_numIndices * sizeof(uint16_t) )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+Mesh* bakedMeshLoad(const char* _filePath, const char* _sourcePath, float _dequantize[4])
+{
+	MappedFile* file = mapFile(_filePath);
+	if (NULL == file)
+	{
+		return NULL;
+	}
+
+	if (!isValid(file) )
+	{
+		unmapFile(file);
+		return NULL;
+	}
+
+	// source changed since baking, baked file without source is kept
+	const MeshHeader* header = (const MeshHeader*)file->m_data;
+	uint64_t sourceSize;
+	uint64_t sourceModified;
+	if (sourceStamp(_sourcePath, sourceSize, sourceModified)
+	&&  (sourceSize != header->m_sourceSize || sourceModified != header->m_sourceModified) )
+	{
+		unmapFile(file);
+		return NULL;
+	}
+	const GroupHeader* groups = (const GroupHeader*)(header + 1);
+	bx::memCopy(_dequantize, header->m_dequantize, sizeof(header->m_dequantize) );
+
+	// hold a reference while creating buffers, bgfx may release some of
+	// them before the last one is created
+	file->m_refs = 1;
+
+	Mesh* mesh = BX_NEW(entry::getAllocator(), Mesh);
+	mesh->m_layout = s_layout;
+	for (uint32_t ii = 0; ii < header->m_numGroups; ++ii)
+	{
+		const GroupHeader& groupHeader = groups[ii];
+		bx::atomicAddAndFetch(&file->m_refs, 2);
+
+		Group group;
+		group.m_vbh = bgfx::createVertexBuffer(
+			  bgfx::makeRef(file->m_data + groupHeader.m_vertexOffset, groupHeader.m_numVertices * sizeof(BakedVertex), releaseMappedFile, file)
+			, s_layout
+			);
+		group.m_ibh = bgfx::createIndexBuffer(
+			  bgfx::makeRef(file->m_data + groupHeader.m_indexOffset, groupHeader.m_numIndices * sizeof(uint16_t), releaseMappedFile, file)
+			);
+		group.m_numVertices = uint16_t(groupHeader.m_numVertices);
+		group.m_vertices = NULL;
+		group.m_numIndices = groupHeader.m_numIndices;
+		group.m_indices = NULL;
+		group.m_sphere.center = { groupHeader.m_sphere[0], groupHeader.m_sphere[1], groupHeader.m_sphere[2] };
+		group.m_sphere.radius = groupHeader.m_sphere[3];
+		group.m_aabb.min = { groupHeader.m_aabbMin[0], groupHeader.m_aabbMin[1], groupHeader.m_aabbMin[2] };
+		group.m_aabb.max = { groupHeader.m_aabbMax[0], groupHeader.m_aabbMax[1], groupHeader.m_aabbMax[2] };
+		mesh->m_groups.push_back(group);
+	}
+
+	releaseMappedFile(NULL, file);
+	return mesh;
+}
+
+} // namespace sss
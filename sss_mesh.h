@@ -0,0 +1,43 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SSS_MESH_H_HEADER_GUARD
+#define SSS_MESH_H_HEADER_GUARD
+
+#include <bx/bx.h>
+
+struct Mesh;
+
+namespace sss
+{
+	// Texture coordinates are stored as snorm16 over this range, must match
+	// BAKED_UV_RANGE in vs_sss_gbuffer.sc
+	#define SSS_MESH_UV_RANGE	8.0f
+
+	// Baked vertex is 16 bytes. Position is snorm16 relative to the mesh's
+	// bounds, normal is oct encoded as in normal_encoding.sh in snorm16 and
+	// texture coordinates are snorm16 scaled by SSS_MESH_UV_RANGE
+	void bakedMeshInit();
+
+	// Path of the baked file next to source mesh, with extension replaced
+	void bakedMeshPath(char* _out, uint32_t _size, const char* _filePath);
+
+	// Write _mesh in baked format. Needs vertices and indices in memory, so
+	// source has to be loaded with ram copy. Size and modification time of
+	// _sourcePath are recorded, so changes to it are detected on load
+	bool bakeMesh(const Mesh* _mesh, const char* _filePath, const char* _sourcePath);
+
+	// Map baked mesh file. Buffers are created from references into the
+	// mapping, which is unmapped once bgfx is done with all of them. Returns
+	// NULL when file is missing, from another version, or baked from another
+	// size or modification time of _sourcePath. When the source itself is
+	// missing, the baked file is used as is. Positions are
+	// quantized as position = quantized * _dequantize.w + _dequantize.xyz,
+	// group bounds are in quantized space. Free with meshUnload.
+	Mesh* bakedMeshLoad(const char* _filePath, const char* _sourcePath, float _dequantize[4]);
+
+} // namespace sss
+
+#endif // SSS_MESH_H_HEADER_GUARD
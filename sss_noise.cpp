@@ -0,0 +1,178 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "sss_noise.h"
+
+#include <bx/math.h>
+#include <bx/rng.h>
+
+namespace sss
+{
+
+// Width of gaussian energy filter, 1.5 as in the paper
+#define NOISE_SIGMA				1.5f
+
+// Share of pixels set in initial binary pattern
+#define NOISE_INITIAL_DENSITY	0.1f
+
+struct NoiseState
+{
+	// energy of pixel ii is sum of gaussian at wrapped distance to every set pixel
+	void toggle(uint32_t _pixel, bool _set)
+	{
+		m_set[_pixel] = _set;
+
+		const float sign = _set ? 1.0f : -1.0f;
+		const uint32_t px = _pixel % m_size;
+		const uint32_t py = _pixel / m_size;
+		for (uint32_t yy = 0; yy < m_size; ++yy)
+		{
+			const uint32_t dy = (yy + m_size - py) % m_size;
+			for (uint32_t xx = 0; xx < m_size; ++xx)
+			{
+				const uint32_t dx = (xx + m_size - px) % m_size;
+				m_energy[yy * m_size + xx] += sign * m_gaussian[dy * m_size + dx];
+			}
+		}
+	}
+
+	// set pixel with highest energy
+	uint32_t tightestCluster() const
+	{
+		uint32_t best = 0;
+		float bestEnergy = -bx::kFloatMax;
+		for (uint32_t ii = 0; ii < m_count; ++ii)
+		{
+			if (m_set[ii] && bestEnergy < m_energy[ii])
+			{
+				best = ii;
+				bestEnergy = m_energy[ii];
+			}
+		}
+		return best;
+	}
+
+	// unset pixel with lowest energy
+	uint32_t largestVoid() const
+	{
+		uint32_t best = 0;
+		float bestEnergy = bx::kFloatMax;
+		for (uint32_t ii = 0; ii < m_count; ++ii)
+		{
+			if (!m_set[ii] && m_energy[ii] < bestEnergy)
+			{
+				best = ii;
+				bestEnergy = m_energy[ii];
+			}
+		}
+		return best;
+	}
+
+	float* m_gaussian;
+	float* m_energy;
+	bool* m_set;
+	uint32_t m_size;
+	uint32_t m_count;
+};
+
+void blueNoise(bx::AllocatorI* _allocator, uint8_t* _values, uint32_t _size, uint32_t _seed)
+{
+	const uint32_t count = _size * _size;
+
+	NoiseState state;
+	state.m_size = _size;
+	state.m_count = count;
+	state.m_gaussian = (float*)BX_ALLOC(_allocator, count * sizeof(float) );
+	state.m_energy = (float*)BX_ALLOC(_allocator, count * sizeof(float) );
+	state.m_set = (bool*)BX_ALLOC(_allocator, count * sizeof(bool) );
+	bool* prototype = (bool*)BX_ALLOC(_allocator, count * sizeof(bool) );
+	uint32_t* rank = (uint32_t*)BX_ALLOC(_allocator, count * sizeof(uint32_t) );
+
+	// filter indexed by wrapped offset, so energy tiles like the texture
+	for (uint32_t yy = 0; yy < _size; ++yy)
+	{
+		const float dy = float(bx::min(yy, _size - yy) );
+		for (uint32_t xx = 0; xx < _size; ++xx)
+		{
+			const float dx = float(bx::min(xx, _size - xx) );
+			state.m_gaussian[yy * _size + xx] = bx::exp(-(dx*dx + dy*dy) / (2.0f * NOISE_SIGMA * NOISE_SIGMA) );
+		}
+	}
+
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		state.m_energy[ii] = 0.0f;
+		state.m_set[ii] = false;
+	}
+
+	// random initial pattern
+	bx::RngMwc rng(_seed);
+	const uint32_t numInitial = bx::max(uint32_t(float(count) * NOISE_INITIAL_DENSITY), 1u);
+	uint32_t numSet = 0;
+	while (numSet < numInitial)
+	{
+		const uint32_t pixel = rng.gen() % count;
+		if (!state.m_set[pixel])
+		{
+			state.toggle(pixel, true);
+			++numSet;
+		}
+	}
+
+	// move tightest cluster to largest void until pattern is evenly spread
+	for (uint32_t iteration = 0; iteration < count; ++iteration)
+	{
+		const uint32_t cluster = state.tightestCluster();
+		state.toggle(cluster, false);
+		const uint32_t hole = state.largestVoid();
+		if (hole == cluster)
+		{
+			state.toggle(cluster, true);
+			break;
+		}
+		state.toggle(hole, true);
+	}
+
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		prototype[ii] = state.m_set[ii];
+	}
+
+	// ranks below prototype, removing tightest clusters first
+	for (uint32_t ii = numSet; 0 < ii; --ii)
+	{
+		const uint32_t cluster = state.tightestCluster();
+		state.toggle(cluster, false);
+		rank[cluster] = ii - 1;
+	}
+
+	// back to prototype, then ranks above it, filling largest voids first
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		if (prototype[ii])
+		{
+			state.toggle(ii, true);
+		}
+	}
+	for (uint32_t ii = numSet; ii < count; ++ii)
+	{
+		const uint32_t hole = state.largestVoid();
+		state.toggle(hole, true);
+		rank[hole] = ii;
+	}
+
+	for (uint32_t ii = 0; ii < count; ++ii)
+	{
+		_values[ii] = uint8_t(uint64_t(rank[ii]) * 256 / count);
+	}
+
+	BX_FREE(_allocator, rank);
+	BX_FREE(_allocator, prototype);
+	BX_FREE(_allocator, state.m_set);
+	BX_FREE(_allocator, state.m_energy);
+	BX_FREE(_allocator, state.m_gaussian);
+}
+
+} // namespace sss
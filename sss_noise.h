@@ -0,0 +1,21 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SSS_NOISE_H_HEADER_GUARD
+#define SSS_NOISE_H_HEADER_GUARD
+
+#include <bx/allocator.h>
+
+namespace sss
+{
+	// Void and cluster blue noise, from "The void-and-cluster method for
+	// dither array generation", Ulichney 1993. Writes _size * _size ranks
+	// spread over 0 to 255, tiling without seams. Cost grows with the square
+	// of pixel count, meant for small textures built once at startup.
+	void blueNoise(bx::AllocatorI* _allocator, uint8_t* _values, uint32_t _size, uint32_t _seed);
+
+} // namespace sss
+
+#endif // SSS_NOISE_H_HEADER_GUARD
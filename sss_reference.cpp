@@ -0,0 +1,389 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "sss_reference.h"
+
+#include <bx/math.h>
+#include <bx/simd_t.h>
+#include <bx/thread.h>
+#include <bx/cpu.h>
+
+namespace sss
+{
+
+// Must match screen_space_shadows.sh
+#define DEPTH_EPSILON			1e-4f
+
+// Rows handed to a thread at a time
+#define REFERENCE_TILE_ROWS		16
+#define REFERENCE_MAX_THREADS	16
+
+// Four pixels marched together
+#define LANES					4
+
+static float shadertoyNoise(float _x, float _y)
+{
+	const float value = bx::sin(_x * 12.9898f + _y * 78.233f) * 43758.5453123f;
+	return value - bx::floor(value);
+}
+
+// point sampled and wrapped like s_blueNoise, shifted by golden ratio per frame
+static float blueNoise(const ReferenceParams& _params, uint32_t _x, uint32_t _y)
+{
+	const uint32_t size = _params.m_blueNoiseSize;
+	const float rank = float(_params.m_blueNoise[(_y % size) * size + _x % size]) / 255.0f;
+	const float value = rank + 0.61803398875f * _params.m_frameIdx;
+	return value - bx::floor(value);
+}
+
+static float smoothstep(float _edge0, float _edge1, float _x)
+{
+	const float tt = bx::clamp((_x - _edge0) / (_edge1 - _edge0), 0.0f, 1.0f);
+	return tt * tt * (3.0f - 2.0f * tt);
+}
+
+// ResolveLinearDepth
+static float depthAt(const ReferenceParams& _params, uint32_t _index)
+{
+	const float depth = _params.m_depth[_index];
+	return _params.m_depthIsHardware ? linearDepth(_params.m_depthUnpackConsts, depth) : depth;
+}
+
+// point sampled and clamped to edge like s_depth, nan goes to first texel
+static float sampleDepth(const ReferenceParams& _params, float _u, float _v)
+{
+	const float maxX = float(_params.m_width  - 1);
+	const float maxY = float(_params.m_height - 1);
+	float xx = _u * float(_params.m_width);
+	float yy = _v * float(_params.m_height);
+	xx = (xx >= 0.0f) ? bx::min(xx, maxX) : 0.0f;
+	yy = (yy >= 0.0f) ? bx::min(yy, maxY) : 0.0f;
+	return depthAt(_params, uint32_t(yy) * _params.m_width + uint32_t(xx) );
+}
+
+// turn accumulated occlusion into shadow, same as end of ScreenSpaceShadow
+static float resolveShadow(
+	  const ReferenceParams& _params
+	, float _occluded
+	, float _softOccluded
+	, float _firstHit
+	, float _distanceToLight
+	, float _initialOffset
+	, float _lengthOfLightStep
+	)
+{
+	const float shadowSteps = float(_params.m_shadowSteps);
+
+	float shadow;
+	if (3 == _params.m_contactShadowsMode)
+	{
+		// percentage closer style soft screen space shadows, from first hit
+		if (0.0f < _occluded)
+		{
+			const float distanceToBlocker = _distanceToLight - (_initialOffset + 1.0f + _firstHit) * _lengthOfLightStep;
+			const float widthOfLight = 1.0f;
+			const float widthOfPenumbra = (_distanceToLight - distanceToBlocker) * widthOfLight / distanceToBlocker;
+			shadow = smoothstep(0.0f, 0.1f, widthOfPenumbra);
+			shadow = shadow*shadow;
+		}
+		else
+		{
+			shadow = 1.0f;
+		}
+	}
+	else if (2 == _params.m_contactShadowsMode)
+	{
+		shadow = _softOccluded * (1.0f - (_firstHit / shadowSteps) );
+		shadow = 1.0f - bx::clamp(shadow, 0.0f, 1.0f);
+		shadow = shadow*shadow;
+	}
+	else if (1 == _params.m_contactShadowsMode)
+	{
+		shadow = _occluded * (1.0f - (_firstHit / shadowSteps) );
+		shadow = 1.0f - bx::clamp(shadow, 0.0f, 1.0f);
+		shadow = shadow*shadow;
+	}
+	else
+	{
+		shadow = 0.0f < _occluded ? 0.0f : 1.0f;
+	}
+
+	return shadow;
+}
+
+// march LANES pixels towards one light. positions, radius and offset are per
+// lane, everything else is shared, so only the depth fetch is scalar
+static void marchLight(
+	  const ReferenceParams& _params
+	, const float* _posX
+	, const float* _posY
+	, const float* _posZ
+	, const float* _radius
+	, const float* _initialOffset
+	, const float* _lightPosition
+	, float* _shadow
+	)
+{
+	using namespace bx;
+
+	const float* mtx = _params.m_viewToProj;
+	const float shadowSteps = float(_params.m_shadowSteps);
+
+	const simd128_t zero = simd_zero();
+	const simd128_t one = simd_splat(1.0f);
+	const simd128_t half = simd_splat(0.5f);
+	const simd128_t epsilon = simd_splat(DEPTH_EPSILON);
+
+	const simd128_t posX = simd_ld(_posX);
+	const simd128_t posY = simd_ld(_posY);
+	const simd128_t posZ = simd_ld(_posZ);
+	const simd128_t radius = simd_ld(_radius);
+	const simd128_t initialOffset = simd_ld(_initialOffset);
+
+	// direction and distance to light
+	const simd128_t toLightX = simd_sub(simd_splat(_lightPosition[0]), posX);
+	const simd128_t toLightY = simd_sub(simd_splat(_lightPosition[1]), posY);
+	const simd128_t toLightZ = simd_sub(simd_splat(_lightPosition[2]), posZ);
+	const simd128_t distanceToLight = simd_sqrt(simd_madd(toLightX, toLightX, simd_madd(toLightY, toLightY, simd_mul(toLightZ, toLightZ) ) ) );
+
+	const simd128_t lengthOfLightStep = simd_div(radius, simd_splat(shadowSteps) );
+	const simd128_t stepScale = simd_div(lengthOfLightStep, distanceToLight);
+	const simd128_t stepX = simd_mul(toLightX, stepScale);
+	const simd128_t stepY = simd_mul(toLightY, stepScale);
+	const simd128_t stepZ = simd_mul(toLightZ, stepScale);
+
+	simd128_t sampleX = simd_madd(initialOffset, stepX, posX);
+	simd128_t sampleY = simd_madd(initialOffset, stepY, posY);
+	simd128_t sampleZ = simd_madd(initialOffset, stepZ, posZ);
+
+	// averageDistanceToBlocker is not accumulated, pcsssss only uses first hit
+	simd128_t occluded = zero;
+	simd128_t softOccluded = zero;
+	simd128_t firstHit = simd_splat(shadowSteps);
+
+	const simd128_t m0 = simd_splat(mtx[0]), m1 = simd_splat(mtx[1]), m3 = simd_splat(mtx[3]);
+	const simd128_t m4 = simd_splat(mtx[4]), m5 = simd_splat(mtx[5]), m7 = simd_splat(mtx[7]);
+	const simd128_t m8 = simd_splat(mtx[8]), m9 = simd_splat(mtx[9]), m11 = simd_splat(mtx[11]);
+	const simd128_t m12 = simd_splat(mtx[12]), m13 = simd_splat(mtx[13]), m15 = simd_splat(mtx[15]);
+
+	BX_ALIGN_DECL_16(float sampleU[LANES]);
+	BX_ALIGN_DECL_16(float sampleV[LANES]);
+
+	for (uint32_t ii = 0; ii < _params.m_shadowSteps; ++ii)
+	{
+		// ViewSpaceToTexCoord, row vector times m_viewToProj like instMul
+		const simd128_t psX = simd_madd(sampleX, m0, simd_madd(sampleY, m4, simd_madd(sampleZ, m8, m12) ) );
+		const simd128_t psY = simd_madd(sampleX, m1, simd_madd(sampleY, m5, simd_madd(sampleZ, m9, m13) ) );
+		const simd128_t psW = simd_madd(sampleX, m3, simd_madd(sampleY, m7, simd_madd(sampleZ, m11, m15) ) );
+		const simd128_t texU = simd_madd(simd_div(psX, psW), half, half);
+		const simd128_t texV = simd_sub(one, simd_madd(simd_div(psY, psW), half, half) );
+		simd_st(sampleU, texU);
+		simd_st(sampleV, texV);
+
+		const simd128_t sampleDepths = simd_ld(
+			  sampleDepth(_params, sampleU[0], sampleV[0])
+			, sampleDepth(_params, sampleU[1], sampleV[1])
+			, sampleDepth(_params, sampleU[2], sampleV[2])
+			, sampleDepth(_params, sampleU[3], sampleV[3])
+			);
+
+		// AccumulateOcclusion
+		const simd128_t delta = simd_sub(sampleZ, sampleDepths);
+		const simd128_t hit = simd_and(simd_cmplt(epsilon, delta), simd_cmplt(delta, radius) );
+		const simd128_t softHit = simd_min(simd_max(simd_sub(radius, delta), zero), one);
+		occluded = simd_add(occluded, simd_and(hit, one) );
+		softOccluded = simd_add(softOccluded, simd_and(hit, softHit) );
+		firstHit = simd_selb(hit, simd_min(firstHit, simd_splat(float(ii) ) ), firstHit);
+
+		sampleX = simd_add(sampleX, stepX);
+		sampleY = simd_add(sampleY, stepY);
+		sampleZ = simd_add(sampleZ, stepZ);
+	}
+
+	BX_ALIGN_DECL_16(float laneOccluded[LANES]);
+	BX_ALIGN_DECL_16(float laneSoftOccluded[LANES]);
+	BX_ALIGN_DECL_16(float laneFirstHit[LANES]);
+	BX_ALIGN_DECL_16(float laneDistanceToLight[LANES]);
+	BX_ALIGN_DECL_16(float laneLengthOfLightStep[LANES]);
+	simd_st(laneOccluded, occluded);
+	simd_st(laneSoftOccluded, softOccluded);
+	simd_st(laneFirstHit, firstHit);
+	simd_st(laneDistanceToLight, distanceToLight);
+	simd_st(laneLengthOfLightStep, lengthOfLightStep);
+
+	for (uint32_t lane = 0; lane < LANES; ++lane)
+	{
+		_shadow[lane] = resolveShadow(_params
+			, laneOccluded[lane]
+			, laneSoftOccluded[lane]
+			, laneFirstHit[lane]
+			, laneDistanceToLight[lane]
+			, _initialOffset[lane]
+			, laneLengthOfLightStep[lane]
+			);
+	}
+}
+
+static void shadeRow(const ReferenceParams& _params, uint32_t _row, float* _shadows)
+{
+	const uint32_t width = _params.m_width;
+	const float texCoordV = (float(_row) + 0.5f) / float(_params.m_height);
+
+	for (uint32_t xx = 0; xx < width; xx += LANES)
+	{
+		BX_ALIGN_DECL_16(float posX[LANES]);
+		BX_ALIGN_DECL_16(float posY[LANES]);
+		BX_ALIGN_DECL_16(float posZ[LANES]);
+		BX_ALIGN_DECL_16(float radius[LANES]);
+		BX_ALIGN_DECL_16(float initialOffset[LANES]);
+
+		// per pixel setup, lanes past end of row repeat last pixel
+		for (uint32_t lane = 0; lane < LANES; ++lane)
+		{
+			const uint32_t pixel = bx::min(xx + lane, width - 1);
+			const float texCoordU = (float(pixel) + 0.5f) / float(width);
+			const float linearDepth = depthAt(_params, _row * width + pixel);
+
+			// NDCToViewspace
+			posX[lane] = (_params.m_ndcToViewMul[0] * texCoordU + _params.m_ndcToViewAdd[0]) * linearDepth;
+			posY[lane] = (_params.m_ndcToViewMul[1] * texCoordV + _params.m_ndcToViewAdd[1]) * linearDepth;
+			posZ[lane] = linearDepth;
+
+			radius[lane] = _params.m_shadowRadius;
+			if (_params.m_useScreenSpaceRadius)
+			{
+				const float radiusTexCoordX = _params.m_shadowRadius / float(width) + texCoordU;
+				const float radiusPositionX = _params.m_ndcToViewMul[0] * radiusTexCoordX + _params.m_ndcToViewAdd[0];
+				radius[lane] = bx::abs(radiusPositionX * linearDepth - posX[lane]);
+			}
+
+			const float random = _params.m_useBlueNoise
+				? blueNoise(_params, pixel, _row)
+				: shadertoyNoise(
+					  float(pixel) + 0.5f + 314.0f * _params.m_frameIdx
+					, float(_row)  + 0.5f + 159.0f * _params.m_frameIdx
+					);
+			initialOffset[lane] = _params.m_useNoiseOffset ? (0.5f + random) : 1.0f;
+		}
+
+		float shadow[SSS_REFERENCE_MAX_LIGHTS][LANES];
+		for (uint32_t light = 0; light < SSS_REFERENCE_MAX_LIGHTS; ++light)
+		{
+			if (light < _params.m_lightCount)
+			{
+				marchLight(_params, posX, posY, posZ, radius, initialOffset, _params.m_lightPosition[light], shadow[light]);
+			}
+			else
+			{
+				for (uint32_t lane = 0; lane < LANES; ++lane)
+				{
+					shadow[light][lane] = 1.0f;
+				}
+			}
+		}
+
+		const uint32_t numLanes = bx::min(uint32_t(LANES), width - xx);
+		for (uint32_t lane = 0; lane < numLanes; ++lane)
+		{
+			float* dst = &_shadows[(_row * width + xx + lane) * SSS_REFERENCE_MAX_LIGHTS];
+			for (uint32_t light = 0; light < SSS_REFERENCE_MAX_LIGHTS; ++light)
+			{
+				dst[light] = shadow[light][lane];
+			}
+		}
+	}
+}
+
+struct ReferenceJob
+{
+	const ReferenceParams* m_params;
+	float* m_shadows;
+	int32_t m_nextTile;
+};
+
+// take tiles of rows until none are left
+static void shadeTiles(ReferenceJob* _job)
+{
+	const ReferenceParams& params = *_job->m_params;
+	for (;;)
+	{
+		const uint32_t tile = uint32_t(bx::atomicFetchAndAdd(&_job->m_nextTile, 1) );
+		const uint32_t firstRow = tile * REFERENCE_TILE_ROWS;
+		if (params.m_height <= firstRow)
+		{
+			break;
+		}
+
+		const uint32_t lastRow = bx::min(firstRow + REFERENCE_TILE_ROWS, params.m_height);
+		for (uint32_t row = firstRow; row < lastRow; ++row)
+		{
+			shadeRow(params, row, _job->m_shadows);
+		}
+	}
+}
+
+static int32_t referenceThreadFunc(bx::Thread* _thread, void* _userData)
+{
+	BX_UNUSED(_thread);
+	shadeTiles( (ReferenceJob*)_userData);
+	return 0;
+}
+
+// from assao sample, cs_assao_prepare_depths.sc
+void depthUnpackConsts(const float* _proj, float _consts[2])
+{
+	// float depthLinearizeMul = ( clipFar * clipNear ) / ( clipFar - clipNear );
+	// float depthLinearizeAdd = clipFar / ( clipFar - clipNear );
+	// correct the handedness issue. need to make sure this below is correct, but I think it is.
+	// with reversed z near and far are swapped, both constants turn negative
+	// and the same linearization holds.
+	float depthLinearizeMul = -_proj[3*4+2];
+	float depthLinearizeAdd =  _proj[2*4+2];
+
+	if (depthLinearizeMul * depthLinearizeAdd < 0.0f)
+	{
+		depthLinearizeAdd = -depthLinearizeAdd;
+	}
+
+	_consts[0] = depthLinearizeMul;
+	_consts[1] = depthLinearizeAdd;
+}
+
+float linearDepth(const float _consts[2], float _depth)
+{
+	return _consts[0] / (_consts[1] - _depth);
+}
+
+void referenceShadows(const ReferenceParams& _params, float* _shadows, uint32_t _numThreads)
+{
+	if (0 == _params.m_width
+	||  0 == _params.m_height
+	||  0 == _params.m_shadowSteps)
+	{
+		return;
+	}
+
+	ReferenceJob job;
+	job.m_params = &_params;
+	job.m_shadows = _shadows;
+	job.m_nextTile = 0;
+
+	// calling thread works on tiles too
+	const uint32_t numWorkers = bx::min(bx::max(_numThreads, 1u), uint32_t(REFERENCE_MAX_THREADS) ) - 1;
+	bx::Thread workers[REFERENCE_MAX_THREADS];
+	for (uint32_t ii = 0; ii < numWorkers; ++ii)
+	{
+		workers[ii].init(referenceThreadFunc, &job, 0, "sss reference");
+	}
+
+	shadeTiles(&job);
+
+	for (uint32_t ii = 0; ii < numWorkers; ++ii)
+	{
+		workers[ii].shutdown();
+	}
+}
+
+} // namespace sss
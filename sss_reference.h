@@ -0,0 +1,66 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#ifndef SSS_REFERENCE_H_HEADER_GUARD
+#define SSS_REFERENCE_H_HEADER_GUARD
+
+#include <bx/bx.h>
+
+namespace sss
+{
+	// Must match MAX_LIGHTS, one light per channel of shadows
+	#define SSS_REFERENCE_MAX_LIGHTS	4
+
+	// Inputs of cpu reference, same values the shadow shader reads from
+	// u_frameParams. Positions and matrices are in view space, as on gpu.
+	struct ReferenceParams
+	{
+		const float* m_depth; // m_width * m_height, rows in texture order
+		uint32_t m_width;
+		uint32_t m_height;
+
+		// m_depth holds hardware depth, linearized with m_depthUnpackConsts
+		// like ResolveLinearDepth, otherwise it is already linear
+		bool m_depthIsHardware;
+		float m_depthUnpackConsts[2];
+
+		float m_viewToProj[16];
+		float m_ndcToViewMul[2];
+		float m_ndcToViewAdd[2];
+
+		float m_lightPosition[SSS_REFERENCE_MAX_LIGHTS][3];
+		uint32_t m_lightCount;
+
+		float m_shadowRadius;
+		bool m_useScreenSpaceRadius;
+		uint32_t m_shadowSteps;
+		uint32_t m_contactShadowsMode;
+		bool m_useNoiseOffset;
+		float m_frameIdx;
+
+		// tiled over pixels like s_blueNoise, when off offset comes from
+		// shadertoy noise
+		bool m_useBlueNoise;
+		const uint8_t* m_blueNoise; // m_blueNoiseSize squared ranks
+		uint32_t m_blueNoiseSize;
+	};
+
+	// Constants turning hardware depth back into linear depth, from a
+	// projection with depth from 0 to 1. Reversed z projects with near and
+	// far swapped, and the same constants hold.
+	void depthUnpackConsts(const float* _proj, float _consts[2]);
+
+	// Linear depth from hardware depth, ScreenSpaceToViewSpaceDepth
+	float linearDepth(const float _consts[2], float _depth);
+
+	// Linear march of fs_screen_space_shadows.sc for every pixel, without
+	// hi-z. Writes SSS_REFERENCE_MAX_LIGHTS floats per pixel, unused lights
+	// are 1.0. Four pixels of a row are marched together with simd, and
+	// tiles of rows are shared between _numThreads threads.
+	void referenceShadows(const ReferenceParams& _params, float* _shadows, uint32_t _numThreads);
+
+} // namespace sss
+
+#endif // SSS_REFERENCE_H_HEADER_GUARD
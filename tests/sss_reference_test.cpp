@@ -0,0 +1,353 @@
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+// Runs the cpu reference of the shadow march over synthetic depth buffers,
+// and compares shadows with golden masks stored next to this file. Needs no
+// gpu, only bx. Run with --update to write golden masks again, after a
+// change to the march that is meant to change results.
+//
+// sss_reference_test <golden directory> [--update]
+
+#include "../sss_reference.h"
+#include "../sss_noise.h"
+
+#include <bx/allocator.h>
+#include <bx/math.h>
+#include <bx/file.h>
+#include <bx/string.h>
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#define TEST_WIDTH			64
+#define TEST_HEIGHT			48
+#define TEST_THREADS		4
+#define TEST_FOV_Y			60.0f
+#define TEST_NEAR			0.01f
+#define TEST_FAR			100.0f
+#define TEST_NOISE_SIZE		64
+#define TEST_NOISE_SEED		1337
+
+// Golden masks are stored as rgba8 like the gpu shadows target. Math
+// functions differ a little between platforms, so values may be off by one
+// step, and a few may flip where a sample lands on an edge. Noise offset
+// amplifies differences of sin, so scenes using it allow more of them
+#define GOLDEN_MAGIC				BX_MAKEFOURCC('S', 'S', 'G', '0')
+#define MAX_STEP_ERROR				1
+#define MAX_MISMATCH_SHARE			0.001f
+#define MAX_NOISE_MISMATCH_SHARE	0.01f
+
+struct Sphere
+{
+	float m_center[3];
+	float m_radius;
+};
+
+struct Box
+{
+	float m_min[3];
+	float m_max[3];
+};
+
+// view space, camera at origin looking down +z, ground plane at y = -1
+static const Box s_box = { { -0.5f, -1.0f, 3.0f }, { 0.5f, 0.0f, 4.0f } };
+
+static const Sphere s_spheres[] =
+{
+	{ { -1.0f, -0.6f, 4.0f }, 0.4f },
+	{ {  0.8f, -0.7f, 3.5f }, 0.3f },
+	{ {  0.0f, -0.5f, 5.5f }, 0.5f },
+};
+
+static const float s_lightPositions[SSS_REFERENCE_MAX_LIGHTS][3] =
+{
+	{  2.0f, 2.0f, 3.0f },
+	{ -2.0f, 1.5f, 2.5f },
+	{  0.0f, 3.0f, 6.0f },
+	{  1.0f, 0.5f, 1.0f },
+};
+
+// How the synthetic depth buffer is stored, as the app's depth sources
+// store it. Hardware depth is linearized by the reference
+struct DepthFormat
+{
+	enum Enum
+	{
+		Linear,
+		D24,
+		D32FReversed,
+	};
+};
+
+struct Scene
+{
+	const char* m_name;
+	bool m_box;
+	bool m_spheres;
+	uint32_t m_lightCount;
+	uint32_t m_contactShadowsMode;
+	uint32_t m_shadowSteps;
+	float m_shadowRadius;
+	bool m_useScreenSpaceRadius;
+	bool m_useNoiseOffset;
+	bool m_useBlueNoise;
+	float m_frameIdx;
+	DepthFormat::Enum m_depthFormat;
+};
+
+static const Scene s_scenes[] =
+{
+	{ "ground_hard",        false, false, 1, 0, 16, 0.25f, false, false, false, 0.0f, DepthFormat::Linear       },
+	{ "box_hard",           true,  false, 2, 0, 16, 0.5f,  false, false, false, 0.0f, DepthFormat::Linear       },
+	{ "box_soft_pixels",    true,  false, 2, 1, 8,  24.0f, true,  false, false, 0.0f, DepthFormat::Linear       },
+	{ "spheres_very_soft",  false, true,  4, 2, 16, 0.5f,  false, false, false, 0.0f, DepthFormat::Linear       },
+	{ "spheres_pcsssss",    true,  true,  4, 3, 32, 0.75f, false, true,  false, 3.0f, DepthFormat::Linear       },
+	{ "box_blue_noise",     true,  true,  4, 1, 16, 0.5f,  false, true,  true,  5.0f, DepthFormat::Linear       },
+	{ "box_hard_d24",       true,  false, 2, 0, 16, 0.5f,  false, false, false, 0.0f, DepthFormat::D24          },
+	{ "spheres_reversed_z", true,  true,  4, 1, 16, 0.5f,  false, false, false, 0.0f, DepthFormat::D32FReversed },
+};
+
+static float intersectPlane(const float* _dir)
+{
+	return 0.0f > _dir[1] ? -1.0f / _dir[1] : TEST_FAR;
+}
+
+static float intersectBox(const Box& _box, const float* _dir)
+{
+	float tMin = 0.0f;
+	float tMax = TEST_FAR;
+	for (uint32_t ii = 0; ii < 3; ++ii)
+	{
+		const float invDir = 1.0f / _dir[ii];
+		const float t0 = _box.m_min[ii] * invDir;
+		const float t1 = _box.m_max[ii] * invDir;
+		tMin = bx::max(tMin, bx::min(t0, t1) );
+		tMax = bx::min(tMax, bx::max(t0, t1) );
+	}
+	return tMin <= tMax ? tMin : TEST_FAR;
+}
+
+static float intersectSphere(const Sphere& _sphere, const float* _dir)
+{
+	const float* cc = _sphere.m_center;
+	const float aa = _dir[0] * _dir[0] + _dir[1] * _dir[1] + _dir[2] * _dir[2];
+	const float bb = _dir[0] * cc[0] + _dir[1] * cc[1] + _dir[2] * cc[2];
+	const float dd = cc[0] * cc[0] + cc[1] * cc[1] + cc[2] * cc[2] - _sphere.m_radius * _sphere.m_radius;
+	const float discriminant = bb * bb - aa * dd;
+	return 0.0f <= discriminant ? (bb - bx::sqrt(discriminant) ) / aa : TEST_FAR;
+}
+
+// Rays have unit z, so distance along ray is linear depth
+static void renderDepth(const Scene& _scene, const sss::ReferenceParams& _params, float* _depth)
+{
+	for (uint32_t yy = 0; yy < TEST_HEIGHT; ++yy)
+	{
+		for (uint32_t xx = 0; xx < TEST_WIDTH; ++xx)
+		{
+			const float texCoord[2] =
+			{
+				(float(xx) + 0.5f) / float(TEST_WIDTH),
+				(float(yy) + 0.5f) / float(TEST_HEIGHT),
+			};
+			const float dir[3] =
+			{
+				_params.m_ndcToViewMul[0] * texCoord[0] + _params.m_ndcToViewAdd[0],
+				_params.m_ndcToViewMul[1] * texCoord[1] + _params.m_ndcToViewAdd[1],
+				1.0f,
+			};
+
+			float depth = intersectPlane(dir);
+			if (_scene.m_box)
+			{
+				depth = bx::min(depth, intersectBox(s_box, dir) );
+			}
+			if (_scene.m_spheres)
+			{
+				for (uint32_t ii = 0; ii < BX_COUNTOF(s_spheres); ++ii)
+				{
+					depth = bx::min(depth, intersectSphere(s_spheres[ii], dir) );
+				}
+			}
+			_depth[yy * TEST_WIDTH + xx] = bx::min(depth, TEST_FAR);
+		}
+	}
+}
+
+// Inverse of ScreenSpaceToViewSpaceDepth, rounded to the precision of the
+// depth format
+static void encodeDepth(const Scene& _scene, const sss::ReferenceParams& _params, float* _depth)
+{
+	if (!_params.m_depthIsHardware)
+	{
+		return;
+	}
+
+	const float mul = _params.m_depthUnpackConsts[0];
+	const float add = _params.m_depthUnpackConsts[1];
+	const float d24Max = float( (1 << 24) - 1);
+	for (uint32_t ii = 0; ii < TEST_WIDTH * TEST_HEIGHT; ++ii)
+	{
+		const float depth = bx::clamp(add - mul / _depth[ii], 0.0f, 1.0f);
+		_depth[ii] = DepthFormat::D24 == _scene.m_depthFormat
+			? bx::round(depth * d24Max) / d24Max
+			: depth
+			;
+	}
+}
+
+// Same matrices and unpack constants as the app on renderers with top left
+// texture origin, reversed z swaps near and far
+static void setupParams(const Scene& _scene, const float* _depth, const uint8_t* _blueNoise, sss::ReferenceParams& _params)
+{
+	const bool reversedZ = DepthFormat::D32FReversed == _scene.m_depthFormat;
+	const float projNear = reversedZ ? TEST_FAR  : TEST_NEAR;
+	const float projFar  = reversedZ ? TEST_NEAR : TEST_FAR;
+	bx::mtxProj(_params.m_viewToProj, TEST_FOV_Y, float(TEST_WIDTH) / float(TEST_HEIGHT), projNear, projFar, false);
+
+	const float tanHalfFOVY = 1.0f / _params.m_viewToProj[1*4+1];
+	const float tanHalfFOVX = 1.0f / _params.m_viewToProj[0];
+	_params.m_ndcToViewMul[0] = tanHalfFOVX * 2.0f;
+	_params.m_ndcToViewMul[1] = tanHalfFOVY * -2.0f;
+	_params.m_ndcToViewAdd[0] = tanHalfFOVX * -1.0f;
+	_params.m_ndcToViewAdd[1] = tanHalfFOVY * 1.0f;
+
+	_params.m_depth = _depth;
+	_params.m_width = TEST_WIDTH;
+	_params.m_height = TEST_HEIGHT;
+	_params.m_depthIsHardware = DepthFormat::Linear != _scene.m_depthFormat;
+	sss::depthUnpackConsts(_params.m_viewToProj, _params.m_depthUnpackConsts);
+	bx::memCopy(_params.m_lightPosition, s_lightPositions, sizeof(_params.m_lightPosition) );
+	_params.m_lightCount = _scene.m_lightCount;
+	_params.m_shadowRadius = _scene.m_shadowRadius;
+	_params.m_useScreenSpaceRadius = _scene.m_useScreenSpaceRadius;
+	_params.m_shadowSteps = _scene.m_shadowSteps;
+	_params.m_contactShadowsMode = _scene.m_contactShadowsMode;
+	_params.m_useNoiseOffset = _scene.m_useNoiseOffset;
+	_params.m_frameIdx = _scene.m_frameIdx;
+	_params.m_useBlueNoise = _scene.m_useBlueNoise;
+	_params.m_blueNoise = _blueNoise;
+	_params.m_blueNoiseSize = TEST_NOISE_SIZE;
+}
+
+static bool writeGolden(const char* _path, const uint8_t* _mask, uint32_t _size)
+{
+	bx::FileWriter writer;
+	if (!bx::open(&writer, _path) )
+	{
+		return false;
+	}
+
+	const uint32_t header[3] = { GOLDEN_MAGIC, TEST_WIDTH, TEST_HEIGHT };
+	bx::write(&writer, header, sizeof(header) );
+	bx::write(&writer, _mask, int32_t(_size) );
+	bx::close(&writer);
+	return true;
+}
+
+static bool readGolden(const char* _path, uint8_t* _mask, uint32_t _size)
+{
+	bx::FileReader reader;
+	if (!bx::open(&reader, _path) )
+	{
+		return false;
+	}
+
+	uint32_t header[3];
+	const bool valid = sizeof(header) == bx::read(&reader, header, sizeof(header) )
+		&& GOLDEN_MAGIC == header[0]
+		&& TEST_WIDTH == header[1]
+		&& TEST_HEIGHT == header[2]
+		&& int32_t(_size) == bx::read(&reader, _mask, int32_t(_size) )
+		;
+	bx::close(&reader);
+	return valid;
+}
+
+int main(int _argc, const char* const* _argv)
+{
+	if (2 > _argc)
+	{
+		printf("usage: sss_reference_test <golden directory> [--update]\n");
+		return EXIT_FAILURE;
+	}
+
+	const char* goldenDir = _argv[1];
+	const bool update = 2 < _argc && 0 == bx::strCmp(_argv[2], "--update");
+
+	const uint32_t numPixels = TEST_WIDTH * TEST_HEIGHT;
+	const uint32_t numValues = numPixels * SSS_REFERENCE_MAX_LIGHTS;
+	bx::DefaultAllocator allocator;
+	float* depth = (float*)BX_ALLOC(&allocator, numPixels * sizeof(float) );
+	float* shadows = (float*)BX_ALLOC(&allocator, numValues * sizeof(float) );
+	uint8_t* mask = (uint8_t*)BX_ALLOC(&allocator, numValues);
+	uint8_t* golden = (uint8_t*)BX_ALLOC(&allocator, numValues);
+
+	// same noise as the app builds for its blue noise texture
+	uint8_t* blueNoise = (uint8_t*)BX_ALLOC(&allocator, TEST_NOISE_SIZE * TEST_NOISE_SIZE);
+	sss::blueNoise(&allocator, blueNoise, TEST_NOISE_SIZE, TEST_NOISE_SEED);
+
+	uint32_t numFailed = 0;
+	for (uint32_t ii = 0; ii < BX_COUNTOF(s_scenes); ++ii)
+	{
+		const Scene& scene = s_scenes[ii];
+
+		sss::ReferenceParams params;
+		setupParams(scene, depth, blueNoise, params);
+		renderDepth(scene, params, depth);
+		encodeDepth(scene, params, depth);
+		sss::referenceShadows(params, shadows, TEST_THREADS);
+
+		// quantized like readback of rgba8 shadows
+		for (uint32_t jj = 0; jj < numValues; ++jj)
+		{
+			mask[jj] = uint8_t(bx::clamp(shadows[jj], 0.0f, 1.0f) * 255.0f + 0.5f);
+		}
+
+		char path[1024];
+		bx::snprintf(path, sizeof(path), "%s/%s.bin", goldenDir, scene.m_name);
+
+		if (update)
+		{
+			const bool written = writeGolden(path, mask, numValues);
+			printf("%-20s %s\n", scene.m_name, written ? "updated" : "failed to write");
+			numFailed += written ? 0 : 1;
+			continue;
+		}
+
+		if (!readGolden(path, golden, numValues) )
+		{
+			printf("%-20s missing or invalid golden mask %s\n", scene.m_name, path);
+			++numFailed;
+			continue;
+		}
+
+		uint32_t mismatch = 0;
+		uint32_t maxError = 0;
+		for (uint32_t jj = 0; jj < numValues; ++jj)
+		{
+			const uint32_t error = mask[jj] > golden[jj] ? mask[jj] - golden[jj] : golden[jj] - mask[jj];
+			maxError = bx::max(maxError, error);
+			mismatch += MAX_STEP_ERROR < error ? 1 : 0;
+		}
+
+		const float mismatchShare = float(mismatch) / float(numValues);
+		const bool passed = mismatchShare <= (scene.m_useNoiseOffset ? MAX_NOISE_MISMATCH_SHARE : MAX_MISMATCH_SHARE);
+		printf("%-20s %s, mismatch %.2f%%, max error %u\n"
+			, scene.m_name
+			, passed ? "ok" : "FAILED"
+			, mismatchShare * 100.0f
+			, maxError
+			);
+		numFailed += passed ? 0 : 1;
+	}
+
+	BX_FREE(&allocator, blueNoise);
+	BX_FREE(&allocator, golden);
+	BX_FREE(&allocator, mask);
+	BX_FREE(&allocator, shadows);
+	BX_FREE(&allocator, depth);
+
+	return 0 == numFailed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -1,6 +1,7 @@
 vec4 a_position  : POSITION;
 vec2 a_texcoord0 : TEXCOORD0;
 vec3 a_normal    : NORMAL;
+vec4 i_data0     : TEXCOORD7;
 
 vec2 v_texcoord0 : TEXCOORD0;
 vec4 v_texcoord1 : TEXCOORD1;
@@ -8,6 +8,10 @@ $output v_normal, v_texcoord0, v_texcoord1
 
 #include "../common/common.sh"
 #include "parameters.sh"
+#include "normal_encoding.sh"
+
+// Must match SSS_MESH_UV_RANGE in sss_mesh.h
+#define BAKED_UV_RANGE 8.0
 
 void main()
 {
@@ -15,16 +19,24 @@ void main()
 	vec3 pos = a_position.xyz;
 	gl_Position = mul(u_modelViewProj, vec4(pos, 1.0));
 
-	// Calculate normal, unpack
+	// Calculate normal, unpack. Baked meshes store oct encoded normal and
+	// scaled texture coordinates, their position dequantization is folded
+	// into model transform
+#if defined(SSS_BAKED_MESH)
+	vec3 osNormal = oct_to_float32x3(a_normal.xy);
+	v_texcoord0 = a_texcoord0 * BAKED_UV_RANGE;
+#else
 	vec3 osNormal = a_normal.xyz * 2.0 - 1.0;
+	v_texcoord0 = a_texcoord0;
+#endif
 
 	// Transform normal into world space
 	vec3 wsNormal = mul(u_model[0], vec4(osNormal, 0.0)).xyz;
 	v_normal.xyz = normalize(wsNormal);
 
-	v_texcoord0 = a_texcoord0;
-
-	// Pass through world space position
+	// Pass through world space position, and view space depth for gbuffer
+	// variants that write linear depth
 	vec3 wsPos  = mul(u_model[0], vec4(pos, 1.0)).xyz;
-	v_texcoord1 = vec4(wsPos, 1.0);
+	float vsDepth = mul(u_modelView, vec4(pos, 1.0)).z;
+	v_texcoord1 = vec4(wsPos, vsDepth);
 }
@@ -0,0 +1,39 @@
+$input a_position, a_normal, a_texcoord0, i_data0
+$output v_normal, v_texcoord0, v_texcoord1
+
+/*
+* Copyright 2021 elven cache. All rights reserved.
+* License: https://github.com/bkaradzic/bgfx#license-bsd-2-clause
+*/
+
+#include "../common/common.sh"
+#include "parameters.sh"
+#include "normal_encoding.sh"
+
+// Must match SSS_MESH_UV_RANGE in sss_mesh.h
+#define BAKED_UV_RANGE 8.0
+
+void main()
+{
+	// Instance data is world space position in xyz and uniform scale in w,
+	// so transform is done without per instance matrix
+	vec3 wsPos = a_position.xyz * i_data0.w + i_data0.xyz;
+	gl_Position = mul(u_viewProj, vec4(wsPos, 1.0));
+
+	// Calculate normal, unpack. Uniform scale doesn't rotate normal. Baked
+	// meshes store oct encoded normal and scaled texture coordinates, their
+	// position dequantization is folded into instance data
+#if defined(SSS_BAKED_MESH)
+	vec3 osNormal = oct_to_float32x3(a_normal.xy);
+	v_texcoord0 = a_texcoord0 * BAKED_UV_RANGE;
+#else
+	vec3 osNormal = a_normal.xyz * 2.0 - 1.0;
+	v_texcoord0 = a_texcoord0;
+#endif
+	v_normal.xyz = normalize(osNormal);
+
+	// Pass through world space position, and view space depth for gbuffer
+	// variants that write linear depth
+	float vsDepth = mul(u_view, vec4(wsPos, 1.0)).z;
+	v_texcoord1 = vec4(wsPos, vsDepth);
+}